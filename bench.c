@@ -0,0 +1,207 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Layout micro-benchmark: runs every layout in config.h against a
+ * synthetic monitor, without a display. Build and run with "make bench".
+ *
+ * ns/arrange is the layout function alone and ns/key is layoutkey().
+ * ns/miss and ns/hit are the part of arrangemon() after packtiled(): the
+ * per-tag geometry lookup, then either the layout and savegeom() when the
+ * inputs changed, or reusing the stored geometry and the applytiled() pass
+ * that finds every client in place. packtiled() and the ConfigureWindow
+ * requests of a miss need X and are not timed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static unsigned long nallocs;
+
+static void *
+benchcalloc(size_t nmemb, size_t size)
+{
+	nallocs++;
+	return calloc(nmemb, size);
+}
+
+static void *
+benchrealloc(void *p, size_t size)
+{
+	nallocs++;
+	return realloc(p, size);
+}
+
+void *
+benchecalloc(size_t nmemb, size_t size)
+{
+	return benchcalloc(nmemb, size);
+}
+
+#define calloc(n, s)  benchcalloc(n, s)
+#define realloc(p, s) benchrealloc(p, s)
+#define ecalloc(n, s) benchecalloc(n, s)
+#define main dwm_main
+#include "dwm.c"
+#undef main
+
+#define NS(T) ((T).tv_sec * 1000000000LL + (T).tv_nsec)
+
+static const unsigned int counts[] = { 1, 2, 3, 5, 10, 20, 50, 100, 200, 500, 1000, 2000 };
+static const float cfacts[] = { 1.0, 0.5, 1.5, 1.0, 2.0, 0.75 };
+
+/* cycled through on every arrange so the numbers are not tied to one
+ * nmaster/gap configuration */
+static const struct {
+	int nmaster, enablegaps;
+} variants[] = {
+	{ 1, 1 }, { 2, 1 }, { 1, 0 }, { 3, 0 },
+};
+
+static Monitor *
+benchmon(unsigned int n)
+{
+	unsigned int i;
+	Monitor *m = createmon();
+	Client *c;
+
+	m->mx = m->wx = 0;
+	m->my = 0;
+	m->wy = bh;
+	m->mw = m->ww = 2560;
+	m->mh = 1440;
+	m->wh = m->mh - bh;
+	m->tiled = ecalloc(n, sizeof(Tiled));
+	m->ntiled = m->tiledsize = n;
+	for (i = 0; i < n; i++) {
+		c = ecalloc(1, sizeof(Client));
+		c->mon = m;
+		c->bw = borderpx;
+		c->cfact = cfacts[i % LENGTH(cfacts)];
+		c->hintsvalid = 1;
+		m->tiled[i].c = c;
+		m->tiled[i].cfact = c->cfact;
+		m->tiled[i].bw = c->bw;
+	}
+	return m;
+}
+
+static void
+freemon(Monitor *m)
+{
+	unsigned int i;
+
+	for (i = 0; i < m->ntiled; i++)
+		free(m->tiled[i].c);
+	for (i = 0; i <= LENGTH(tags); i++) {
+		free(m->pertag->geoms[i]);
+		free(m->pertag->keys[i]);
+	}
+	free(m->tiled);
+	free(m->key);
+	free(m->pertag);
+	free(m);
+}
+
+/* moves the clients where the last arrange put them, as resizeclient()
+ * would, so applytiled() has nothing to send */
+static void
+placemon(Monitor *m)
+{
+	unsigned int i;
+	int bw = m->lt[m->sellt]->arrange == monocle;
+	Tiled *t;
+
+	for (i = 0; i < m->ntiled; i++) {
+		t = &m->tiled[i];
+		t->c->x = t->r.x;
+		t->c->y = t->r.y;
+		t->c->w = t->r.w + (bw ? 2 * t->bw : 0);
+		t->c->h = t->r.h + (bw ? 2 * t->bw : 0);
+	}
+}
+
+static void
+setvariant(Monitor *m, unsigned int v)
+{
+	v %= LENGTH(variants);
+	m->nmaster = variants[v].nmaster;
+	m->pertag->enablegaps[m->pertag->curtag] = variants[v].enablegaps;
+}
+
+int
+main(void)
+{
+	unsigned int i, j, l, n, iters;
+	unsigned long allocs;
+	unsigned long long sink = 0;
+	long long arrangens, keyns, missns, hitns;
+	struct timespec t0, t1;
+	Monitor *m;
+
+	bh = 22;
+	printf("%-6s %5s %12s %10s %10s %10s %8s\n", "layout", "n",
+		"ns/arrange", "ns/key", "ns/miss", "ns/hit", "allocs");
+	for (l = 0; l < LENGTH(layouts); l++) {
+		if (!layouts[l].arrange)
+			continue;
+		for (j = 0; j < LENGTH(counts); j++) {
+			n = counts[j];
+			iters = MAX(64, 400000 / n);
+			mons = selmon = m = benchmon(n);
+			m->lt[m->sellt] = &layouts[l];
+
+			/* warm up */
+			for (i = 0; i < LENGTH(variants); i++) {
+				setvariant(m, i);
+				layouts[l].arrange(m);
+			}
+
+			allocs = nallocs;
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			for (i = 0; i < iters; i++) {
+				setvariant(m, i);
+				layouts[l].arrange(m);
+			}
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			arrangens = NS(t1) - NS(t0);
+			allocs = nallocs - allocs;
+
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			for (i = 0; i < iters; i++) {
+				setvariant(m, i);
+				sink += layoutkey(m);
+			}
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			keyns = NS(t1) - NS(t0);
+
+			/* the variant changes on every pass, so each lookup misses */
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			for (i = 0; i < iters; i++) {
+				setvariant(m, i);
+				if (!loadgeom(m)) {
+					layouts[l].arrange(m);
+					savegeom(m);
+				}
+			}
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			missns = NS(t1) - NS(t0);
+
+			placemon(m);
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			for (i = 0; i < iters; i++) {
+				if (!loadgeom(m))
+					die("bench: the geometry of an unchanged tag was not reused");
+				applytiled(m);
+			}
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			hitns = NS(t1) - NS(t0);
+
+			printf("%-6s %5u %12.1f %10.1f %10.1f %10.1f %8.2f\n",
+				layouts[l].symbol, n, (double)arrangens / iters,
+				(double)keyns / iters, (double)missns / iters,
+				(double)hitns / iters, (double)allocs / iters);
+			freemon(m);
+		}
+	}
+	/* keep the key loop from being optimized away */
+	return sink == 1;
+}
@@ -28,6 +28,10 @@ static const int windowtitletpad    = 1;         /* window title top padding */
 static const int layoutlpad         = -4;        /* layout left padding */
 static const int layouttpad         = -1;        /* layout top padding */
 static const int attachmode         = 4;         /* default attach mode: 0 = dwm/top, 1 = below, 2 = above, 3 = bottom, 4 = aside */
+static const int statsenabled       = 0;         /* 1 means time the event handlers from startup (see stats.c) */
+static const int traceenabled       = 0;         /* 1 means record a trace from startup (see trace.c) */
+static const int procconnector      = 1;         /* 1 means follow processes over the linux proc connector if permitted (see proc.c) */
+static const int renderthread       = 0;         /* 1 means draw the bars on a thread with its own X connection (see render.c) */
 #define ICONSIZE    17                           /* icon size */
 #define ICONSPACING 5                            /* space between icon and title */
 #define SHOWWINICON 1                            /* 0 means no winicon */
@@ -44,7 +48,9 @@ static const char *fonts[]          = {
 const int enablecolorfonts          = 1;  /* color fonts require libxft 2.3.5 or newer */
 const int removevs16codepoints      = 1;  /* remove VS15, VS16 and zero-width-joiner codepoints/glyphs from emojis */
 
-#define NOTIFYFONT                    "JetBrainsMono Nerd Font 12"
+static const char *osdfonts[]       = { "JetBrainsMono Nerd Font:size=12:antialias=true" };
+static const unsigned int osdtimeout = 1500; /* ms the on-screen display stays up, 0 disables it */
+static const int spawnlauncher      = 1;  /* 1 means commands are spawned by a helper forked at startup */
 static const char dmenufont[]       = "JetBrainsMono Nerd Font:size=10.5:antialias=true";
 static const char dmenuheight[]     = "23";
 
@@ -90,6 +96,7 @@ const char *spcmd1[] = {"st", "-A", "0.95", "-n", "spterm", "-g", "125x38", NULL
 const char *spcmd2[] = {"st", "-A", "0.95", "-n", "spfm", "-g", "142x42", "-e", "lf - File Manager", NULL };
 const char *spcmd3[] = {"qalculate-gtk", NULL };
 const char *spcmd4[] = {"easyeffects", NULL };
+static const int prewarmscratch     = 1;  /* 1 means scratchpads are started hidden and restarted when they exit */
 static Sp scratchpads[] = {
 	/* name          cmd  */
 	{"spterm",      spcmd1},
@@ -153,6 +160,11 @@ struct Pertag {
 	int enablegaps[LENGTH(tags) + 1]; /* vanitygaps */
 	unsigned int gaps[LENGTH(tags) + 1]; /* vanitycaps */
 	Client *prevzooms[LENGTH(tags) + 1]; /* zoomswap */
+	unsigned long long geomkeys[LENGTH(tags) + 1]; /* hash of the last arrange */
+	Rect *geoms[LENGTH(tags) + 1]; /* geometry of the last arrange */
+	unsigned int ngeoms[LENGTH(tags) + 1];
+	unsigned long long *keys[LENGTH(tags) + 1]; /* layoutkey() words behind geomkeys */
+	unsigned int nkeys[LENGTH(tags) + 1];
 };
 #define PERTAG_PATCH 1
 #define FORCE_VSPLIT 1  /* nrowgrid layout: force two clients to always split vertically */
@@ -251,15 +263,15 @@ static const char *printscrgui[]     = { "xfce4-screenshooter", NULL };
 static const char *printscrscr[]     = { "xfce4-screenshooter", "-f", NULL };
 static const char *printscrwin[]     = { "xfce4-screenshooter", "-w", "--no-border", NULL };
 static const char *printscrsel[]     = { "flameshot", "gui", NULL };
-static const char *backlightup1[]    = { "sigdsblocks", "7", "+1", NULL };      /*  +1%  */
-static const char *backlightdown1[]  = { "sigdsblocks", "7", "-1", NULL };      /*  -1%  */
-static const char *backlightup[]     = { "sigdsblocks", "7", "+5", NULL };      /*  +5%  */
-static const char *backlightdown[]   = { "sigdsblocks", "7", "-5", NULL };      /*  -5%  */
-static const char *volumeup[]        = { "sigdsblocks", "1", "+5", NULL };      /*  +5%  */
-static const char *volumedown[]      = { "sigdsblocks", "1", "-5", NULL };      /*  -5%  */
-static const char *volumeboostup[]   = { "sigdsblocks", "1", "1005", NULL };    /*  +5%  */
-static const char *volumeboostdown[] = { "sigdsblocks", "1", "995", NULL };     /*  -5%  */
-static const char *volumemute[]      = { "sigdsblocks", "1", "-1000", NULL };
+static const int backlightup1[]      = { 7, +1 };     /*  +1%  */
+static const int backlightdown1[]    = { 7, -1 };     /*  -1%  */
+static const int backlightup[]       = { 7, +5 };     /*  +5%  */
+static const int backlightdown[]     = { 7, -5 };     /*  -5%  */
+static const int volumeup[]          = { 1, +5 };     /*  +5%  */
+static const int volumedown[]        = { 1, -5 };     /*  -5%  */
+static const int volumeboostup[]     = { 1, 1005 };   /*  +5%  */
+static const int volumeboostdown[]   = { 1, 995 };    /*  -5%  */
+static const int volumemute[]        = { 1, -1000 };
 static const char *xmenuapps[]       = { "xmenu-apps", NULL };
 static const char *lock[]            = { "dwm-lock", "forcelock", NULL };
 
@@ -396,15 +408,15 @@ static const Key keys[] = {
 	{ ShiftMask,                    XK_Print,  spawn,          {.v = printscrscr } },
 	{ Alt,                          XK_Print,  spawn,          {.v = printscrwin } },
 	{ ControlMask,                  XK_Print,  spawn,          {.v = printscrsel } },
-	{ 0, XF86XK_MonBrightnessUp,               spawn,          {.v = backlightup } },
-	{ 0, XF86XK_MonBrightnessDown,             spawn,          {.v = backlightdown } },
-	{ ShiftMask, XF86XK_MonBrightnessUp,       spawn,          {.v = backlightup1 } },
-	{ ShiftMask, XF86XK_MonBrightnessDown,     spawn,          {.v = backlightdown1 } },
-	{ 0, XF86XK_AudioRaiseVolume,              spawn,          {.v = volumeup } },
-	{ 0, XF86XK_AudioLowerVolume,              spawn,          {.v = volumedown } },
-	{ ShiftMask, XF86XK_AudioRaiseVolume,      spawn,          {.v = volumeboostup } },
-	{ ShiftMask, XF86XK_AudioLowerVolume,      spawn,          {.v = volumeboostdown } },
-	{ 0, XF86XK_AudioMute,                     spawn,          {.v = volumemute } },
+	{ 0, XF86XK_MonBrightnessUp,               sigdsblocksval, {.v = backlightup } },
+	{ 0, XF86XK_MonBrightnessDown,             sigdsblocksval, {.v = backlightdown } },
+	{ ShiftMask, XF86XK_MonBrightnessUp,       sigdsblocksval, {.v = backlightup1 } },
+	{ ShiftMask, XF86XK_MonBrightnessDown,     sigdsblocksval, {.v = backlightdown1 } },
+	{ 0, XF86XK_AudioRaiseVolume,              sigdsblocksval, {.v = volumeup } },
+	{ 0, XF86XK_AudioLowerVolume,              sigdsblocksval, {.v = volumedown } },
+	{ ShiftMask, XF86XK_AudioRaiseVolume,      sigdsblocksval, {.v = volumeboostup } },
+	{ ShiftMask, XF86XK_AudioLowerVolume,      sigdsblocksval, {.v = volumeboostdown } },
+	{ 0, XF86XK_AudioMute,                     sigdsblocksval, {.v = volumemute } },
 	{ Alt|ControlMask,              XK_l,      spawn,          {.v = lock } },
 	{ MODKEY|ShiftMask|ControlMask, XK_r,      spawn,          SHCMD("dwm-restart") },
 	{ Alt|ControlMask,              XK_Delete, spawn,          {.v = powermenu } },
@@ -461,18 +473,82 @@ sigreboot(const Arg *arg)
 void
 sigrefreshsystrayhandler(const Arg *arg)
 {
-	systraytimer = 0;
 	refreshsystray();
 }
 
+void
+sigsetattach(const Arg *arg)
+{
+	if (arg->i >= 0 && arg->i < LENGTH(attachs))
+		setattach(&((Arg){.v = &attachs[arg->i]}));
+}
+
+void
+sigsetlayout(const Arg *arg)
+{
+	if (arg->i >= 0 && arg->i < LENGTH(layouts) - 1)
+		setlayout(&((Arg){.v = &layouts[arg->i]}));
+}
+
+void
+sigspawn(const Arg *arg)
+{
+	if (arg->v)
+		spawn(&((Arg){.v = (const char*[]){ "/bin/sh", "-c", arg->v, NULL }}));
+}
+
+void
+sigtogglescratch(const Arg *arg)
+{
+	if (arg->ui < LENGTH(scratchpads))
+		togglescratch(arg);
+}
+
 /* signal definitions */
-/* signum must be greater than 0 */
-/* trigger signals using `xsetroot -name "fsignal:<signame> [<type> <value>]"` */
+/* send signals using `dwm -c <signame> [<type> <value>]`, where type is i, ui, f or s */
 static Signal signals[] = {
-	/* signum           function */
-	{ "quit",           quit },
-	{ "restart",        sigrestart },
-	{ "poweroff",       sigpoweroff },
-	{ "reboot",         sigreboot },
-	{ "refreshsystray", sigrefreshsystrayhandler },
+	/* signum                function */
+	{ "quit",                quit },
+	{ "restart",             sigrestart },
+	{ "poweroff",            sigpoweroff },
+	{ "reboot",              sigreboot },
+	{ "refreshsystray",      sigrefreshsystrayhandler },
+	{ "spawn",               sigspawn },              /* s: shell command */
+	{ "view",                view },                  /* ui: tag mask */
+	{ "toggleview",          toggleview },            /* ui: tag mask */
+	{ "tag",                 tag },                   /* ui: tag mask */
+	{ "toggletag",           toggletag },             /* ui: tag mask */
+	{ "togglealttag",        togglealttag },
+	{ "focusmon",            focusmon },              /* i: direction */
+	{ "tagmon",              tagmon },                /* i: direction */
+	{ "focusstackvis",       focusstackvis },         /* i: direction */
+	{ "focusstackhid",       focusstackhid },         /* i: direction */
+	{ "focusdir",            focusdir },              /* i: 0 left, 1 right, 2 up, 3 down */
+	{ "swapfocus",           swapfocus },
+	{ "pushclient",          pushclient },            /* i: direction */
+	{ "inplacerotate",       inplacerotate },         /* i: direction */
+	{ "zoom",                zoom },
+	{ "zoomswap",            zoomswap },
+	{ "killclient",          killclient },
+	{ "hide",                hide },
+	{ "show",                show },
+	{ "incnmaster",          incnmaster },            /* i: delta */
+	{ "setmfact",            setmfact },              /* f: delta, or 1.0 + absolute value */
+	{ "setcfact",            setcfact },              /* f: delta, 0 resets */
+	{ "setlayout",           sigsetlayout },          /* i: index into layouts[] */
+	{ "cyclelayout",         cyclelayout },           /* i: direction */
+	{ "setattach",           sigsetattach },          /* i: index into attachs[] */
+	{ "cycleattach",         cycleattach },           /* i: direction */
+	{ "incrgaps",            incrgaps },              /* i: delta */
+	{ "togglegaps",          togglegaps },
+	{ "defaultgaps",         defaultgaps },
+	{ "togglebar",           togglebar },
+	{ "togglefloating",      togglefloating },
+	{ "togglesticky",        togglesticky },
+	{ "togglefullscreen",    togglefullscreen },
+	{ "togglefakefullscreen", togglefakefullscreen },
+	{ "togglescratch",       sigtogglescratch },      /* ui: index into scratchpads[] */
+	{ "moveresize",          moveresize },            /* s: "<x>x <y>y <w>w <h>h" */
+	{ "moveresizeedge",      moveresizeedge },        /* s: t, b, l, r, T, B, L or R */
+	{ "aspectresize",        aspectresize },          /* i: delta */
 };
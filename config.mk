@@ -38,7 +38,7 @@ IMLIB2LIB = `$(PKG_CONFIG) --libs imlib2`
 
 # includes and libs
 INCS = -I${X11INC} -I${FREETYPEINC} ${IMLIB2INC}
-LIBS = -L${X11LIB} -lX11 ${XINERAMALIBS} ${FREETYPELIBS} ${IMLIB2LIB} -lXrender -lX11-xcb -lxcb -lxcb-res ${KVMLIB} ${PROCSTAT}
+LIBS = -L${X11LIB} -lX11 ${XINERAMALIBS} ${FREETYPELIBS} ${IMLIB2LIB} -lXrender -lX11-xcb -lxcb -lxcb-res -lpthread ${KVMLIB} ${PROCSTAT}
 
 # flags
 CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_XOPEN_SOURCE=700L -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS} ${BSDFLAGS}
@@ -50,5 +50,13 @@ LDFLAGS  = ${LIBS}
 #CFLAGS = -fast ${INCS} -DVERSION=\"${VERSION}\"
 #LDFLAGS = ${LIBS}
 
+# end-to-end benchmark (make e2e) and replay of a recording made with
+# dwm -r (make replay), need Xvfb; the screen should match the recording
+E2EDISPLAY = :99
+E2ESCREEN = 1920x1080x24
+E2EFLAGS = -b -i -n 50 -t 500 -k 500
+E2ELIBS = -lXtst -lXdamage
+REPLAY = dwm.rec
+
 # compiler and linker
 CC = cc
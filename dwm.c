@@ -54,8 +54,21 @@
 #include <sys/sysctl.h>
 #include <libprocstat.h>
 #endif /* __FreeBSD */
+#include <dirent.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
 #include <time.h>
+#include <sys/socket.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#endif /* __linux__ */
 
 #include "drw.h"
 #include "util.h"
@@ -71,16 +84,25 @@
 #define MOUSEMASK               (BUTTONMASK|PointerMotionMask)
 #define WIDTH(X)                ((X)->w + 2 * (X)->bw)
 #define HEIGHT(X)               ((X)->h + 2 * (X)->bw)
+#define TWIDTH(X)               ((X)->r.w + 2 * (X)->bw)
+#define THEIGHT(X)              ((X)->r.h + 2 * (X)->bw)
 #define NUMTAGS                 (LENGTH(tags) + LENGTH(scratchpads))
 #define TAGMASK                 ((1 << NUMTAGS) - 1)
 #define SPTAG(i)                ((1 << LENGTH(tags)) << (i))
 #define SPTAGMASK               (((1 << LENGTH(scratchpads))-1) << LENGTH(tags))
-#define TEXTW(X)                (drw_fontset_getwidth(drw, (X)) + lrpad)
-#define TTEXTW(X)               (drw_fontset_getwidth(drw, (X)))
+#define TEXTW(X)                (xftwidth(drw, (X)) + lrpad)
+#define TTEXTW(X)               (xftwidth(drw, (X)))
 #define ATTACH(C)               (C->mon->att[c->mon->selatt]->attach(C))
 
 #define STATUSLENGTH            256
-#define DSBLOCKSLOCKFILE        "/var/local/dsblocks/dsblocks.pid"
+#define SCRATCHSTARTTIME        5000                 /* ms a scratchpad gets to map its window */
+#define SCRATCHRESPAWNDELAY     1000                 /* ms before an exited scratchpad is started again */
+#define CMDOUTPUTSIZE           256                  /* output kept from a runcmd() command */
+#define PROCCACHESIZE           256                  /* parent pids cached, power of two */
+#define PROCMAXDEPTH            64                   /* ancestors termforwin() looks at */
+#define DSBLOCKSLOCKDIR         "/var/local/dsblocks"
+#define DSBLOCKSLOCKNAME        "dsblocks.pid"
+#define DSBLOCKSLOCKFILE        DSBLOCKSLOCKDIR "/" DSBLOCKSLOCKNAME
 #define DELIMITERENDCHAR        10
 #define LSPAD                   (statuslpad >= 0 ? statuslpad : lrpad / 2)    /* status text left padding */
 #define RSPAD                   (statusrpad >= 0 ? statusrpad : lrpad / 2)    /* status text right padding */
@@ -119,6 +141,8 @@ enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast }; /* default atoms *
 enum { ClkTagBar, ClkAttSymbol, ClkLtSymbol, ClkStatusText, ClkWinTitle,
        ClkClientWin, ClkRootWin, ClkLast }; /* clicks */
 enum { FontDefault, FontStatusMonitor, FontWindowTitle }; /* fonts */
+enum { WatchX, WatchTimer, WatchSignal, WatchIpc, WatchIpcClient, WatchProc, WatchCmd, WatchDsblocks, WatchRender, WatchLast }; /* watched fds */
+enum { TimerSystray, TimerOsd, TimerScratch, TimerLast }; /* timers */
 
 typedef union {
 	int i;
@@ -137,6 +161,7 @@ typedef struct {
 
 typedef struct Monitor Monitor;
 typedef struct Client Client;
+typedef struct Tiled Tiled;
 struct Client {
 	char name[256];
 	float mina, maxa;
@@ -150,6 +175,7 @@ struct Client {
 	unsigned int switchtag;
 	int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen, issticky, isterminal, noswallow;
 	int fakefullscreen;
+	int grabbed; /* catch-all button grab of unfocused clients in place */
 	unsigned int icw, ich;
 	Picture icon;
 	Client *next;
@@ -168,6 +194,11 @@ typedef struct {
 	const Arg arg;
 } Key;
 
+typedef struct {
+	KeyCode code;
+	unsigned int mod;
+} KeyGrab;
+
 typedef struct {
 	const char *symbol;
 	void (*arrange)(Monitor *);
@@ -179,6 +210,17 @@ typedef struct {
 } Attach;
 
 typedef struct Pertag Pertag;
+typedef struct {
+	int x, y, w, h;
+} Rect;
+
+struct Tiled {
+	Client *c;
+	float cfact;
+	int bw;
+	Rect r;               /* geometry computed by the layout */
+};
+
 struct Monitor {
 	char ltsymbol[16];
 	float mfact;
@@ -201,6 +243,14 @@ struct Monitor {
 	int topbar;
 	int hidsel;
 	int statushandcursor;
+	int bardirty;         /* bar needs to be redrawn once the event queue is drained */
+	int arrangedirty;     /* arrange deferred by a batch */
+	int restackdirty;     /* restack deferred by a batch */
+	Tiled *tiled;         /* visible tiled clients, packed by arrangemon() */
+	unsigned int ntiled, tiledsize;
+	unsigned long long geomkey; /* layoutkey() of the current arrange */
+	unsigned long long *key;    /* and the words it hashed */
+	unsigned int nkey, keysize;
 	Client *clients;
 	Client *sel;
 	Client *stack;
@@ -235,9 +285,25 @@ struct Systray {
 	Client *icons;
 };
 
+typedef struct {
+	pid_t pid, ppid;
+} ProcEntry;
+
+typedef struct Cmd Cmd;
+struct Cmd {
+	int fd;                        /* read end of the command's stdout */
+	void (*done)(const char *out); /* called with the output once it is closed */
+	char out[CMDOUTPUTSIZE];
+	size_t len;
+	Cmd *next;
+};
+
 /* function declarations */
 static void applyrules(Client *c);
+static void armtimers(void);
+static void applyhints(Client *c, int *w, int *h);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
+static void applytiled(Monitor *m);
 static void arrange(Monitor *m);
 static void arrangemon(Monitor *m);
 static void aspectresize(const Arg *arg);
@@ -247,12 +313,16 @@ static void attachaside(Client *c);
 static void attachbelow(Client *c);
 static void attachbottom(Client *c);
 static void attachmenu(const Arg *arg);
+static void attachmenudone(const char *out);
 static void attachstack(Client *c);
 static void buttonpress(XEvent *e);
 static void checkotherwm(void);
 static void cleanup(void);
 static void cleanupmon(Monitor *mon);
 static void clientmessage(XEvent *e);
+static void cmdclose(Cmd *c);
+static void cmdread(int fd);
+static void commitbatch(void);
 static void configure(Client *c);
 static void configurenotify(XEvent *e);
 static void configurerequest(XEvent *e);
@@ -263,6 +333,7 @@ static void cyclelayout(const Arg *arg);
 static void destroynotify(XEvent *e);
 static void detach(Client *c);
 static void detachstack(Client *c);
+static void dispatch(XEvent *ev);
 static Monitor *dirtomon(int dir);
 static void dragcfact(const Arg *arg);
 static void dragmfact(const Arg *arg);
@@ -270,7 +341,8 @@ static void drawbar(Monitor *m);
 static void drawbars(void);
 /* static void enternotify(XEvent *e); */
 static void expose(XEvent *e);
-static int fake_signal(void);
+static int findkey(KeySym keysym, unsigned int mod);
+static unsigned long long floatword(float f);
 static void focus(Client *c);
 static void focusdir(const Arg *arg);
 static void focusin(XEvent *e);
@@ -279,24 +351,44 @@ static void focusstackvis(const Arg *arg);
 static void focusstackhid(const Arg *arg);
 static void focusstack(int inc, int vis);
 static Atom getatomprop(Client *c, Atom prop);
+static long long getmsec(void);
+#if defined(__linux__)
+static pid_t getdsblockspid(void);
+#endif /* __linux__ */
 static pid_t getparentprocess(pid_t p);
 static int getrootptr(int *x, int *y);
 static long getstate(Window w);
 static unsigned int getsystraywidth(void);
 static int gettextprop(Window w, Atom atom, char *text, unsigned int size);
 static void grabbuttons(Client *c, int focused);
+static void grabkey(const KeyGrab *g, int grab);
 static void grabkeys(void);
+static void grabrootbuttons(void);
+static void hashkeys(void);
+static unsigned long long hashword(unsigned long long h, unsigned long long v);
+static void handlesignal(int sig);
 static void hide(const Arg *arg);
 static void hidewin(Client *c);
 static void incnmaster(const Arg *arg);
 static void inplacerotate(const Arg *arg);
-static int isdescprocess(pid_t p, pid_t c);
+static void ipcaccept(int fd);
+static void ipccleanup(void);
+static void ipcevent(int ev, const char *fmt, ...);
+static void ipcnotify(void);
+static void ipcread(int fd);
+static int ipcsend(int argc, char *argv[]);
+static void ipcsetup(void);
 static int isprocessrunning(int pid);
+static int keygrabcmp(const void *a, const void *b);
 static void keypress(XEvent *e);
 static void keyrelease(XEvent *e);
+static int keysymcmp(const void *a, const void *b);
 static void killclient(const Arg *arg);
+static unsigned long long layoutkey(Monitor *m);
+static int loadgeom(Monitor *m);
 static void killscratchpads(void);
 static void layoutmenu(const Arg *arg);
+static void layoutmenudone(const char *out);
 static void left_or_master(const Arg *arg);
 static void losefullscreen(Client *next);
 static void manage(Window w, XWindowAttributes *wa);
@@ -307,16 +399,32 @@ static void motionnotify(XEvent *e);
 static void movemouse(const Arg *arg);
 static void moveresize(const Arg *arg);
 static void moveresizeedge(const Arg *arg);
+static long long nexttimer(void);
 static Client *nexttiled(Client *c);
 static Client *nexttiledall(Client *c);
+static void osd(const char *fmt, ...);
+static void osdhide(void);
+static void packtiled(Monitor *m);
+static unsigned long long pairword(int a, int b);
+static void placetiled(Monitor *m, Tiled *t, int x, int y, int w, int h);
 static void pop(Client *c);
+static void prewarmscratchpads(void);
+static void procread(int fd);
 static void propertynotify(XEvent *e);
 static void pushclient(const Arg *arg);
 static void quit(const Arg *arg);
+static pid_t readparentprocess(pid_t p);
+static void readdsblocks(int fd);
+static void readsignals(int fd);
+static void readtimer(int fd);
 static Monitor *recttomon(int x, int y, int w, int h);
 static void refreshsystray(void);
 static void removesystrayicon(Client *i);
 static int removeorphanedsystrayicons(void);
+static void renderbar(Monitor *m);
+static void renderbars(void);
+static void renderread(int fd);
+static void repaint(void);
 static void resize(Client *c, int x, int y, int w, int h, int interact);
 static void resizebarwin(Monitor *m);
 static void resizeclient(Client *c, int x, int y, int w, int h);
@@ -325,6 +433,9 @@ static void resizerequest(XEvent *e);
 static void restack(Monitor *m);
 static void right_or_stack(const Arg *arg);
 static void run(void);
+static void runcmd(const char *cmd, void (*done)(const char *out));
+static void savegeom(Monitor *m);
+static void runtimers(void);
 static void scan(void);
 static int sendevent(Window w, Atom proto, int m, long d0, long d1, long d2, long d3, long d4);
 static void sendmon(Client *c, Monitor *m);
@@ -338,6 +449,7 @@ static void setlayout(const Arg *arg);
 static void setcfact(const Arg *arg);
 static void setmfact(const Arg *arg);
 static void setsystraytimer(void);
+static void settimer(int id, int ms);
 static void setup(void);
 static void seturgent(Client *c, int urg);
 static void shiftviewclients(const Arg *arg);
@@ -345,7 +457,13 @@ static void show(const Arg *arg);
 static void showwin(Client *c);
 static void showhide(Client *c);
 static void sigdsblocks(const Arg *arg);
+static void sigdsblocksval(const Arg *arg);
+static void sigdsblocksqueue(int sig, int value);
+#if !defined(__linux__)
+static void sigforward(int sig);
+#endif /* __linux__ */
 static void spawn(const Arg *arg);
+static void spawnscratch(unsigned int i);
 static Monitor *systraytomon(Monitor *m);
 static int swallow(Client *p, Client *c);
 static Client *swallowingclient(Window w);
@@ -360,6 +478,7 @@ static void togglebar(const Arg *arg);
 static void togglefakefullscreen(const Arg *arg);
 static void togglefloating(const Arg *arg);
 static void togglefullscreen(const Arg *arg);
+static Client *scratchclient(unsigned int i);
 static void togglescratch(const Arg *arg);
 static void togglesticky(const Arg *arg);
 static void toggletag(const Arg *arg);
@@ -369,6 +488,7 @@ static void unfocus(Client *c, int setfocus);
 static void unmanage(Client *c, int destroyed);
 static void unmapnotify(XEvent *e);
 static void unswallow(Client *c);
+static void unwatchfd(int fd);
 static void updatebarpos(Monitor *m);
 static void updatebars(void);
 static void updateclientlist(void);
@@ -384,6 +504,9 @@ static void updatetitle(Client *c);
 static void updatewindowtype(Client *c);
 static void updatewmhints(Client *c);
 static void view(const Arg *arg);
+static void waitevents(void);
+static void watchfd(int fd, int type);
+static void watchfdwrite(int fd, int type, int enable);
 static pid_t winpid(Window w);
 static Client *wintoclient(Window w);
 static Monitor *wintomon(Window w);
@@ -406,6 +529,11 @@ static int wstext;                  /* width of status text */
 static int lrpad;                   /* sum of left and right padding for text */
 static int (*xerrorxlib)(Display *, XErrorEvent *);
 static unsigned int dsblockssig;
+#if defined(__linux__)
+static pid_t dsblockspid;           /* cached while the lock file directory is watched */
+#endif /* __linux__ */
+static int dsblocksfd = -1;         /* the lock file, kept open for F_GETLK */
+static int dsblockswatch = -1;      /* inotify on DSBLOCKSLOCKDIR */
 static unsigned int numlockmask = 0;
 static void (*handler[LASTEvent]) (XEvent *) = {
 	[ButtonPress] = buttonpress,
@@ -428,6 +556,8 @@ static void (*handler[LASTEvent]) (XEvent *) = {
 static Atom wmatom[WMLast], netatom[NetLast], xatom[XLast];
 static int exitcode = EXIT_QUIT;
 static int running = 1;
+static int batch;                   /* arrange and restack are deferred until commitbatch() */
+static int stats;                   /* time the event handlers, see stats.c */
 static Cur *cursor[CurLast];
 static Clr **scheme;
 static Display *dpy;
@@ -435,11 +565,48 @@ static Drw *drw;
 static Monitor *mons, *selmon;
 static Window root, wmcheckwin;
 static Systray *systray =  NULL;
-static int systraytimer;
 static xcb_connection_t *xcon;
+static sigset_t origsigmask;        /* signal mask restored in spawned children */
+static int sigfd[2] = { -1, -1 };   /* signalfd on linux, self-pipe elsewhere */
+static ProcEntry proccache[PROCCACHESIZE];
+static Cmd *cmds;                   /* commands whose output is still being read */
+static long long timers[TimerLast]; /* monotonic deadlines in ms, 0 when disarmed */
+static void (*timerhandler[TimerLast]) (void) = {
+	[TimerSystray] = refreshsystray,
+	[TimerOsd] = osdhide,
+	[TimerScratch] = prewarmscratchpads,
+};
+static void (*watchhandler[WatchLast]) (int fd) = {
+	[WatchX] = NULL, /* events are drained with XPending() in run() */
+	[WatchTimer] = readtimer,
+	[WatchSignal] = readsignals,
+	[WatchIpc] = ipcaccept,
+	[WatchIpcClient] = ipcread,
+	[WatchProc] = procread,
+	[WatchCmd] = cmdread,
+	[WatchDsblocks] = readdsblocks,
+	[WatchRender] = renderread,
+};
+#if defined(__linux__)
+static int epollfd = -1;
+static int timerfd = -1;
+#else
+static struct pollfd watches[16];
+static int watchtypes[LENGTH(watches)];
+static int nwatches;
+#endif /* __linux__ */
 
 /* configuration, allows nested code to access above variables */
 #include "config.h"
+#include "rules.c"
+#include "ipc.c"
+#include "trace.c"
+#include "stats.c"
+#include "record.c"
+#include "proc.c"
+#include "render.c"
+#include "osd.c"
+#include "spawn.c"
 
 #if SHOWWINICON
 static void freeicon(Client *c);
@@ -447,6 +614,14 @@ static Picture geticonprop(Window w, unsigned int *icw, unsigned int *ich);
 static void updateicon(Client *c);
 #endif
 
+static int keyhash[2 * LENGTH(keys) + 1];   /* 1 + first keys[] index of a keysym and mask, 0 if free */
+static int keynext[LENGTH(keys)];           /* next key with the same keysym and mask, -1 at the end */
+static unsigned int keymods[LENGTH(keys)];  /* CLEANMASK(keys[i].mod) */
+static unsigned int keyorder[LENGTH(keys)]; /* keys[] indices sorted by keysym */
+static KeyGrab *keygrabs;                   /* grabbed keycodes and masks, sorted */
+static unsigned int nkeygrabs, keygrabsnumlock;
+static long long scratchstarted[LENGTH(scratchpads)]; /* when spawnscratch() last ran */
+
 /* compile-time check if all tags fit into an unsigned int bit array. */
 struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 
@@ -454,9 +629,9 @@ struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 void
 applyrules(Client *c)
 {
-	const char *class, *instance;
-	unsigned int i, newtagset;
-	const Rule *r;
+	const char *fields[RuleLast];
+	unsigned int i, n, newtagset, matched[LENGTH(rules)];
+	const Rule *r, *sw = NULL;
 	Monitor *m;
 	XClassHint ch = { NULL, NULL };
 
@@ -464,45 +639,46 @@ applyrules(Client *c)
 	c->isfloating = 0;
 	c->tags = 0;
 	XGetClassHint(dpy, c->win, &ch);
-	class    = ch.res_class ? ch.res_class : broken;
-	instance = ch.res_name  ? ch.res_name  : broken;
-
-	for (i = 0; i < LENGTH(rules); i++) {
-		r = &rules[i];
-		if ((!r->title || strstr(c->name, r->title))
-		&& (!r->class || strstr(class, r->class))
-		&& (!r->instance || strstr(instance, r->instance)))
-		{
-			c->isterminal = r->isterminal;
-			c->noswallow  = r->noswallow;
-			c->isfloating = r->isfloating;
-			c->tags |= r->tags;
-			if ((r->tags & SPTAGMASK) && r->isfloating) {
-				c->x = c->mon->wx + (c->mon->ww / 2 - WIDTH(c) / 2);
-				c->y = c->mon->wy + (c->mon->wh / 2 - HEIGHT(c) / 2);
-			}
+	fields[RuleClass]    = ch.res_class ? ch.res_class : broken;
+	fields[RuleInstance] = ch.res_name  ? ch.res_name  : broken;
+	fields[RuleTitle]    = c->name;
+
+	n = rulesfind(fields, matched);
+	for (i = 0; i < n; i++) {
+		r = &rules[matched[i]];
+		c->isterminal = r->isterminal;
+		c->noswallow  = r->noswallow;
+		c->isfloating = r->isfloating;
+		c->tags |= r->tags;
+		if ((r->tags & SPTAGMASK) && r->isfloating) {
+			c->x = c->mon->wx + (c->mon->ww / 2 - WIDTH(c) / 2);
+			c->y = c->mon->wy + (c->mon->wh / 2 - HEIGHT(c) / 2);
+		}
 
-			for (m = mons; m && m->num != r->monitor; m = m->next);
-			if (m)
-				c->mon = m;
-			
-			if (r->switchtag) {
-				selmon = c->mon;
-				if (r->switchtag == 2 || r->switchtag == 4)
-					newtagset = c->mon->tagset[c->mon->seltags] ^ c->tags;
-				else
-					newtagset = c->tags;
-
-				if (newtagset && !(c->tags & c->mon->tagset[c->mon->seltags])) {
-					if (r->switchtag == 3 || r->switchtag == 4)
-						c->switchtag = c->mon->tagset[c->mon->seltags];
-					if (r->switchtag == 1 || r->switchtag == 3)
-						view(&((Arg) { .ui = newtagset }));
-					else {
-						c->mon->tagset[c->mon->seltags] = newtagset;
-						arrange(c->mon);
-					}
-				}
+		for (m = mons; m && m->num != r->monitor; m = m->next);
+		if (m)
+			c->mon = m;
+
+		if (r->switchtag)
+			sw = r;
+	}
+
+	/* switch tags once, by the last matching rule that asks for it */
+	if (sw) {
+		selmon = c->mon;
+		if (sw->switchtag == 2 || sw->switchtag == 4)
+			newtagset = c->mon->tagset[c->mon->seltags] ^ c->tags;
+		else
+			newtagset = c->tags;
+
+		if (newtagset && !(c->tags & c->mon->tagset[c->mon->seltags])) {
+			if (sw->switchtag == 3 || sw->switchtag == 4)
+				c->switchtag = c->mon->tagset[c->mon->seltags];
+			if (sw->switchtag == 1 || sw->switchtag == 3)
+				view(&((Arg) { .ui = newtagset }));
+			else {
+				c->mon->tagset[c->mon->seltags] = newtagset;
+				arrange(c->mon);
 			}
 		}
 	}
@@ -513,10 +689,45 @@ applyrules(Client *c)
 	c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : (c->mon->tagset[c->mon->seltags] & ~SPTAGMASK);
 }
 
+void
+applyhints(Client *c, int *w, int *h)
+{
+	int baseismin;
+
+	/* see last two sentences in ICCCM 4.1.2.3 */
+	baseismin = c->basew == c->minw && c->baseh == c->minh;
+	if (!baseismin) { /* temporarily remove base dimensions */
+		*w -= c->basew;
+		*h -= c->baseh;
+	}
+	/* adjust for aspect limits */
+	if (c->mina > 0 && c->maxa > 0) {
+		if (c->maxa < (float)*w / *h)
+			*w = *h * c->maxa + 0.5;
+		else if (c->mina < (float)*h / *w)
+			*h = *w * c->mina + 0.5;
+	}
+	if (baseismin) { /* increment calculation requires this */
+		*w -= c->basew;
+		*h -= c->baseh;
+	}
+	/* adjust for increment value */
+	if (c->incw)
+		*w -= *w % c->incw;
+	if (c->inch)
+		*h -= *h % c->inch;
+	/* restore base dimensions */
+	*w = MAX(*w + c->basew, c->minw);
+	*h = MAX(*h + c->baseh, c->minh);
+	if (c->maxw)
+		*w = MIN(*w, c->maxw);
+	if (c->maxh)
+		*h = MIN(*h, c->maxh);
+}
+
 int
 applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 {
-	int baseismin;
 	Monitor *m = c->mon;
 
 	/* set minimum possible */
@@ -548,42 +759,59 @@ applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 	if (resizehints || c->isfloating || !c->mon->lt[c->mon->sellt]->arrange) {
 		if (!c->hintsvalid)
 			updatesizehints(c);
-		/* see last two sentences in ICCCM 4.1.2.3 */
-		baseismin = c->basew == c->minw && c->baseh == c->minh;
-		if (!baseismin) { /* temporarily remove base dimensions */
-			*w -= c->basew;
-			*h -= c->baseh;
-		}
-		/* adjust for aspect limits */
-		if (c->mina > 0 && c->maxa > 0) {
-			if (c->maxa < (float)*w / *h)
-				*w = *h * c->maxa + 0.5;
-			else if (c->mina < (float)*h / *w)
-				*h = *w * c->mina + 0.5;
-		}
-		if (baseismin) { /* increment calculation requires this */
-			*w -= c->basew;
-			*h -= c->baseh;
-		}
-		/* adjust for increment value */
-		if (c->incw)
-			*w -= *w % c->incw;
-		if (c->inch)
-			*h -= *h % c->inch;
-		/* restore base dimensions */
-		*w = MAX(*w + c->basew, c->minw);
-		*h = MAX(*h + c->baseh, c->minh);
-		if (c->maxw)
-			*w = MIN(*w, c->maxw);
-		if (c->maxh)
-			*h = MIN(*h, c->maxh);
+		applyhints(c, w, h);
 	}
 	return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
 }
 
+/* sends the geometry computed by the layout to X, skipping the clients
+ * that are already in place */
+void
+applytiled(Monitor *m)
+{
+	unsigned int i;
+	int bw;
+	Tiled *t;
+	Client *c;
+
+	/* resizeclient() strips the borders of tiled clients in monocle */
+	bw = m->lt[m->sellt]->arrange == monocle;
+	for (i = 0; i < m->ntiled; i++) {
+		t = &m->tiled[i];
+		c = t->c;
+		if (t->r.x != c->x || t->r.y != c->y
+		|| t->r.w + (bw ? 2 * t->bw : 0) != c->w
+		|| t->r.h + (bw ? 2 * t->bw : 0) != c->h)
+			resizeclient(c, t->r.x, t->r.y, t->r.w, t->r.h);
+	}
+}
+
+void
+armtimers(void)
+{
+#if defined(__linux__)
+	long long t;
+	struct itimerspec its = {0};
+
+	if ((t = nexttimer())) {
+		its.it_value.tv_sec = t / 1000;
+		its.it_value.tv_nsec = t % 1000 * 1000000;
+	}
+	timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+#endif /* __linux__ */
+}
+
 void
 arrange(Monitor *m)
 {
+	if (batch) {
+		if (m)
+			m->arrangedirty = m->restackdirty = 1;
+		else for (m = mons; m; m = m->next)
+			m->arrangedirty = 1;
+		return;
+	}
+	TRACEBEGIN("arrange");
 	if (m)
 		showhide(m->stack);
 	else for (m = mons; m; m = m->next)
@@ -593,15 +821,26 @@ arrange(Monitor *m)
 		restack(m);
 	} else for (m = mons; m; m = m->next)
 		arrangemon(m);
+	TRACEEND("arrange");
 }
 
 void
 arrangemon(Monitor *m)
 {
+	TRACEBEGIN("arrangemon");
+	packtiled(m);
 	strncpy(m->ltsymbol, m->lt[m->sellt]->symbol, sizeof m->ltsymbol-1);
 	m->ltsymbol[sizeof m->ltsymbol-1] = '\0';
-	if (m->lt[m->sellt]->arrange)
-		m->lt[m->sellt]->arrange(m);
+	if (m->lt[m->sellt]->arrange) {
+		if (!loadgeom(m)) {
+			TRACEBEGIN(m->lt[m->sellt]->symbol);
+			m->lt[m->sellt]->arrange(m);
+			TRACEEND(m->lt[m->sellt]->symbol);
+			savegeom(m);
+		}
+		applytiled(m);
+	}
+	TRACEEND("arrangemon");
 }
 
 void
@@ -700,19 +939,18 @@ attachbottom(Client *c)
 
 void
 attachmenu(const Arg *arg) {
-	FILE *p;
-	char c[3], *s;
-	int i;
-
-	if (!(p = popen(attachmenucmd, "r")))
-		 return;
-	s = fgets(c, sizeof(c), p);
-	pclose(p);
+	runcmd(attachmenucmd, attachmenudone);
+}
 
-	if (!s || *s == '\0' || *c == '\0')
-		 return;
+void
+attachmenudone(const char *out)
+{
+	char *end;
+	long i;
 
-	i = atoi(c);
+	i = strtol(out, &end, 10);
+	if (end == out || i < 0 || i >= LENGTH(attachs))
+		return;
 	setattach(&((Arg) { .v = &attachs[i] }));
 }
 
@@ -726,13 +964,26 @@ attachstack(Client *c)
 void
 buttonpress(XEvent *e)
 {
-	int i, x;
+	int i, x, timed;
+	StatMark mark;
 	unsigned int click;
 	Arg arg = {0};
 	Client *c;
 	Monitor *m;
 	XButtonPressedEvent *ev = &e->xbutton;
 
+	/* a binding grabbed on the root window, see grabrootbuttons() */
+	if (ev->window == root) {
+		c = ev->subwindow ? wintoclient(ev->subwindow) : NULL;
+		if (ev->subwindow && !c) {
+			XAllowEvents(dpy, ReplayPointer, CurrentTime);
+			return;
+		}
+		XAllowEvents(dpy, AsyncPointer, CurrentTime);
+		if (c)
+			ev->window = c->win;
+	}
+
 	/* focus monitor if necessary */
 	if ((m = wintomon(ev->window)) && m != selmon
 		&& (focusonwheel || (ev->button != Button4 && ev->button != Button5))) {
@@ -741,6 +992,9 @@ buttonpress(XEvent *e)
 		focus(NULL);
 	}
 	if (ev->window == selmon->barwin) {
+		/* click regions are computed while painting, so bring them up to date */
+		if (selmon->bardirty)
+			renderbar(selmon);
 		if (ev->x < bte) {
 			i = -1, x = -ev->x;
 			do
@@ -792,8 +1046,13 @@ buttonpress(XEvent *e)
 
 	for (i = 0; i < LENGTH(buttons); i++)
 		if (click == buttons[i].click && buttons[i].func && buttons[i].button == ev->button
-		&& CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state))
+		&& CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state)) {
+			if ((timed = stats))
+				statsbegin(&mark);
 			buttons[i].func((click == ClkTagBar || click == ClkWinTitle) && buttons[i].arg.i == 0 ? &arg : &buttons[i].arg);
+			if (timed)
+				statsend(&buttonstats[i], &mark);
+		}
 }
 
 void
@@ -815,6 +1074,7 @@ cleanup(void)
 	Monitor *m;
 	size_t i;
 
+	renderstop();
 	view(&a);
 	selmon->lt[selmon->sellt] = &foo;
 	for (m = mons; m; m = m->next)
@@ -834,16 +1094,36 @@ cleanup(void)
 		drw_scm_free(drw, scheme[i], 3);
 	free(scheme);
 	XDestroyWindow(dpy, wmcheckwin);
+	osdcleanup();
 	drw_free(drw);
 	XSync(dpy, False);
 	XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
 	XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
+	ipccleanup();
+	proccleanup();
+	rulesfree();
+	spawncleanup();
+	if (dsblockswatch != -1)
+		close(dsblockswatch);
+	if (dsblocksfd != -1)
+		close(dsblocksfd);
+	while (cmds)
+		cmdclose(cmds);
+	recordstop();
+#if defined(__linux__)
+	close(timerfd);
+	close(epollfd);
+#else
+	close(sigfd[1]);
+#endif /* __linux__ */
+	close(sigfd[0]);
 }
 
 void
 cleanupmon(Monitor *mon)
 {
 	Monitor *m;
+	unsigned int i;
 
 	if (mon == mons)
 		mons = mons->next;
@@ -853,6 +1133,13 @@ cleanupmon(Monitor *mon)
 	}
 	XUnmapWindow(dpy, mon->barwin);
 	XDestroyWindow(dpy, mon->barwin);
+	free(mon->tiled);
+	free(mon->key);
+	for (i = 0; i <= LENGTH(tags); i++) {
+		free(mon->pertag->geoms[i]);
+		free(mon->pertag->keys[i]);
+	}
+	free(mon->pertag);
 	free(mon);
 }
 
@@ -937,6 +1224,72 @@ clientmessage(XEvent *e)
 	}
 }
 
+void
+cmdclose(Cmd *c)
+{
+	Cmd **p;
+
+	for (p = &cmds; *p != c; p = &(*p)->next);
+	*p = c->next;
+	unwatchfd(c->fd);
+	close(c->fd);
+	free(c);
+}
+
+/* collects output until the command closes its stdout; the exit status is
+ * collected with the other children on SIGCHLD */
+void
+cmdread(int fd)
+{
+	char buf[CMDOUTPUTSIZE];
+	ssize_t n;
+	size_t len;
+	Cmd *c;
+
+	for (c = cmds; c && c->fd != fd; c = c->next);
+	if (!c)
+		return;
+	while ((n = read(fd, buf, sizeof(buf))) != 0) {
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+			break;
+		}
+		len = MIN((size_t)n, sizeof(c->out) - 1 - c->len);
+		memcpy(c->out + c->len, buf, len);
+		c->len += len;
+	}
+	c->out[c->len] = '\0';
+	c->done(c->out);
+	cmdclose(c);
+}
+
+/* runs the arranges and restacks deferred since batch was set, in the
+ * same order arrange() would have */
+void
+commitbatch(void)
+{
+	Monitor *m;
+
+	batch = 0;
+	for (m = mons; m; m = m->next)
+		if (m->arrangedirty)
+			showhide(m->stack);
+	for (m = mons; m; m = m->next)
+		if (m->arrangedirty) {
+			m->arrangedirty = 0;
+			arrangemon(m);
+		}
+	for (m = mons; m; m = m->next)
+		if (m->restackdirty) {
+			m->restackdirty = 0;
+			restack(m);
+		}
+	osdflush();
+}
+
 void
 configure(Client *c)
 {
@@ -1298,6 +1651,7 @@ dragcfact(const Arg *arg)
 	                                            (!py) ? c->h/2 : (py > 0) ? 0 : c->h);
 	prev_x = prev_y = -999999;
 
+	osdhold = 1;
 	do {
 		XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
 		switch(ev.type) {
@@ -1332,12 +1686,14 @@ dragcfact(const Arg *arg)
 			break;
 		}
 	} while (ev.type != ButtonRelease);
+	osdhold = 0;
 
 	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, (!px) ? c->w/2 : (px < 0) ? 0 : c->w,
 	                                            (!py) ? c->h/2 : (py > 0) ? 0 : c->h);
 
 	XUngrabPointer(dpy, CurrentTime);
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
+	osdflush();
 }
 
 void
@@ -1416,6 +1772,7 @@ dragmfact(const Arg *arg)
 		return;
 	XWarpPointer(dpy, None, root, 0, 0, 0, 0, px, py);
 
+	osdhold = 1;
 	do {
 		XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
 		switch(ev.type) {
@@ -1459,162 +1816,37 @@ dragmfact(const Arg *arg)
 			break;
 		}
 	} while (ev.type != ButtonRelease);
+	osdhold = 0;
 
 	XUngrabPointer(dpy, CurrentTime);
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
+	osdflush();
 }
 
 void
-drawbar(Monitor *m)
+dispatch(XEvent *ev)
 {
-	int x, w, n = 0, scm;
-	int wbar = m->ww;
-	int boxs = drw->fonts->h / 9;
-	int boxw = drw->fonts->h / 6 + 2;
-	unsigned int i, occ = 0, urg = 0;
-	Client *c;
+	StatMark mark;
 
-	if (!m->showbar)
+	if (!handler[ev->type])
 		return;
+	if (recordfile)
+		recordevent('e', ev);
+	TRACEBEGIN(evnames[ev->type]);
+	if (stats) {
+		statsrecord(&queuestats, XEventsQueued(dpy, QueuedAlready));
+		statsbegin(&mark);
+		handler[ev->type](ev); /* call handler */
+		statsend(&evstats[ev->type], &mark);
+	} else
+		handler[ev->type](ev); /* call handler */
+	TRACEEND(evnames[ev->type]);
+}
 
-	if (showsystray && !systrayonleft && m == systraytomon(m)) {
-		wbar -= getsystraywidth();
-	}
-
-	/* draw status first so it can be overdrawn by tags later */
-	if (m == selmon) { /* status is only drawn on selected monitor */
-		char *stc = stextc;
-		char *stp = stextc;
-		char tmp;
-		int blkw;
-
-		setfont(FontStatusMonitor);
-
-		wsbar = wbar;
-		drw_setscheme(drw, scheme[SchemeNorm]);
-		x = wbar - wstext;
-		drw_rect(drw, x, 0, LSPAD, bh, 1, 1); x += LSPAD; /* to keep left padding clean */
-		for (;;) {
-			if ((unsigned char)*stc >= ' ') {
-				stc++;
-				continue;
-			}
-			tmp = *stc;
-			if (stp != stc) {
-				*stc = '\0';
-				blkw = TTEXTW(stp);
-				if (statustpad > 0)
-					drw_rect(drw, x, 0, blkw, statustpad, 1, 1);
-				x = drw_text(drw, x, statustpad, blkw, bh, 0, stp, 0);
-			}
-			if (tmp == '\0')
-				break;
-			if (tmp - DELIMITERENDCHAR - 1 < LENGTH(colors))
-				drw_setscheme(drw, scheme[tmp - DELIMITERENDCHAR - 1]);
-			*stc = tmp;
-			stp = ++stc;
-		}
-		drw_setscheme(drw, scheme[SchemeNorm]);
-		drw_rect(drw, x, 0, wbar - x, bh, 1, 1); /* to keep right padding clean */
-
-		setfont(FontDefault);
-	}
-
-	for (c = m->clients; c; c = c->next) {
-		if (ISVISIBLE(c))
-			n++;
-		occ |= c->tags;
-		if (c->isurgent)
-			urg |= c->tags;
-	}
-	x = 0;
-	for (i = 0; i < LENGTH(tags); i++) {
-		w = TEXTW(tags[i]);
-		drw_setscheme(drw, scheme[m->tagset[m->seltags] & 1 << i ? SchemeSel : SchemeNorm]);
-		drw_text(drw, x, 0, w, bh, lrpad / 2, (selmon->alttag ? tagsalt[i] : tags[i]), urg & 1 << i);
-		if (occ & 1 << i)
-			drw_rect(drw, x + boxs, boxs, boxw, boxw,
-				m == selmon && selmon->sel && selmon->sel->tags & 1 << i,
-				urg & 1 << i);
-		x += w;
-	}
-	bte = x;
-
-	drw_setscheme(drw, scheme[SchemeNorm]);
-	w = TEXTW(m->att[m->selatt]->symbol);
-	x = drw_text(drw, x, 0, w, bh, lrpad / 2, m->att[m->selatt]->symbol, 0);
-	bae = x;
-
-	w = TEXTW(m->ltsymbol);
-	x = drw_text(drw, x + layoutlpad, layouttpad, w, bh, lrpad / 2, m->ltsymbol, 0);
-	ble = x;
-
-	if (m == selmon) {
-		w = wbar - wstext - x;
-	} else {
-		w = wbar - x;
-	}
-	if (showsystray && systrayonleft && m == systraytomon(m))
-		w -= getsystraywidth();
-
-	if (w > bh) {
-		setfont(FontWindowTitle);
-
-		if (n > 0) {
-			int remainder = w % n + 1;
-			int tabw = w / n + 1;
-			int stw = boxw | 1;
-			for (c = m->clients; c; c = c->next) {
-				if (!ISVISIBLE(c))
-					continue;
-				if (m->sel == c)
-					scm = m->hidsel ? SchemeHidSel : SchemeTitleSel;
-				else if (HIDDEN(c))
-					scm = SchemeHid;
-				else
-					scm = SchemeTitle;
-				drw_setscheme(drw, scheme[scm]);
-
-				if (--remainder == 0)
-						tabw--;
-				if (windowtitletpad > 0)
-					drw_rect(drw, x, 0, tabw, windowtitletpad, 1, 1);
-				#if SHOWWINICON
-				drw_text(drw, x, windowtitletpad, tabw, bh, lrpad / 2 + (c->icon ? c->icw + ICONSPACING : 0), c->name, 0);
-				if (c->icon)
-					drw_pic(drw, x + lrpad / 2, (bh - c->ich) / 2, c->icw, c->ich, c->icon);
-				#else
-				drw_text(drw, x, windowtitletpad, tabw, bh, lrpad / 2, c->name, 0);
-				#endif
-				if (c->isfloating) {
-					drw_rect(drw, x + boxs, boxs, boxw, boxw, c->isfixed, 0);
-				}
-				if (c->issticky) {
-					drw_rect(drw, x + boxs, bh - boxs - stw/2 - 1, stw, 1, 1, 0);
-					drw_rect(drw, x + boxs + stw/2, bh - boxs - stw, 1, stw, 1, 0);
-				}
-				x += tabw;
-			}
-		} else {
-			drw_setscheme(drw, scheme[SchemeNorm]);
-			drw_rect(drw, x, 0, w, bh, 1, 1);
-			x += w;
-		}
-		/* keep systray area clean */
-		if (showsystray && systrayonleft && m == systraytomon(m)) {
-			drw_setscheme(drw, scheme[SchemeNorm]);
-			drw_rect(drw, x, 0, getsystraywidth(), bh, 1, 1);
-		}
-
-		setfont(FontDefault);
-	}
-
-	m->bt = n;
-	m->btw = w;
-	XMoveResizeWindow(dpy, m->barwin, m->wx, m->by, wbar, bh);
-	drw_map(drw, m->barwin, 0, 0, wbar, bh);
-
-	refreshsystray();
+void
+drawbar(Monitor *m)
+{
+	m->bardirty = 1;
 }
 
 void
@@ -1653,54 +1885,36 @@ expose(XEvent *e)
 	Monitor *m;
 	XExposeEvent *ev = &e->xexpose;
 
-	if (ev->count == 0 && (m = wintomon(ev->window))) {
-		drawbar(m);
+	if (ev->window == osdwin) {
+		if (ev->count == 0)
+			osddraw();
+	} else if (ev->count == 0 && (m = wintomon(ev->window))) {
+		renderbar(m);
 		if (m == selmon)
 			updatesystray();
 	}
 }
 
 int
-fake_signal(void)
-{
-	char fsignal[256];
-	char indicator[9] = "fsignal:";
-	char str_sig[50];
-	char param[16];
-	int i, len_str_sig, n, paramn;
-	size_t len_fsignal, len_indicator = strlen(indicator);
-	Arg arg;
-
-	// Get root name property
-	if (gettextprop(root, XA_WM_NAME, fsignal, sizeof(fsignal))) {
-		len_fsignal = strlen(fsignal);
-
-		// Check if this is indeed a fake signal
-		if (len_indicator > len_fsignal ? 0 : strncmp(indicator, fsignal, len_indicator) == 0) {
-			paramn = sscanf(fsignal+len_indicator, "%s%n%s%n", str_sig, &len_str_sig, param, &n);
-
-			if (paramn == 1) arg = (Arg) {0};
-			else if (paramn > 2) return 1;
-			else if (strncmp(param, "i", n - len_str_sig) == 0)
-				sscanf(fsignal + len_indicator + n, "%i", &(arg.i));
-			else if (strncmp(param, "ui", n - len_str_sig) == 0)
-				sscanf(fsignal + len_indicator + n, "%u", &(arg.ui));
-			else if (strncmp(param, "f", n - len_str_sig) == 0)
-				sscanf(fsignal + len_indicator + n, "%f", &(arg.f));
-			else return 1;
-
-			// Check if a signal was found, and if so handle it
-			for (i = 0; i < LENGTH(signals); i++)
-				if (strncmp(str_sig, signals[i].sig, len_str_sig) == 0 && signals[i].func)
-					signals[i].func(&(arg));
-
-			// A fake signal was sent
-			return 1;
-		}
-	}
+findkey(KeySym keysym, unsigned int mod)
+{
+	unsigned int h = (keysym * 31 + mod) % LENGTH(keyhash);
+	int i;
 
-	// No fake signal was sent, so proceed with update
-	return 0;
+	for (; (i = keyhash[h] - 1) >= 0; h = (h + 1) % LENGTH(keyhash))
+		if (keys[i].keysym == keysym && keymods[i] == mod)
+			return i;
+	return -1;
+}
+
+/* layoutkey() words: a float or a pair of ints per 64-bit word */
+unsigned long long
+floatword(float f)
+{
+	unsigned int u;
+
+	memcpy(&u, &f, sizeof u);
+	return u;
 }
 
 void
@@ -1989,8 +2203,67 @@ geticonprop(Window win, unsigned int *picw, unsigned int *pich)
 
 #endif
 
+long long
+getmsec(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000LL + t.tv_nsec / 1000000;
+}
+
+#if defined(__linux__)
+/* the pid of dsblocks is the owner of the lock on its pid file. It is
+ * cached until something opens, closes, creates or removes the file. */
+pid_t
+getdsblockspid(void)
+{
+	struct flock fl;
+	int retry;
+
+	if (dsblockspid > 0)
+		return dsblockspid;
+	for (retry = dsblocksfd != -1; ; retry = 0) {
+		if (dsblocksfd == -1 && (dsblocksfd = open(DSBLOCKSLOCKFILE, O_RDONLY | O_CLOEXEC)) == -1)
+			return 0;
+		fl.l_type = F_WRLCK;
+		fl.l_whence = SEEK_SET;
+		fl.l_start = 0;
+		fl.l_len = 0;
+		if (fcntl(dsblocksfd, F_GETLK, &fl) != -1 && fl.l_type == F_WRLCK)
+			break;
+		/* the file may have been replaced since it was opened */
+		close(dsblocksfd);
+		dsblocksfd = -1;
+		if (!retry)
+			return 0;
+	}
+	if (dsblockswatch != -1)
+		dsblockspid = fl.l_pid;
+	return fl.l_pid;
+}
+#endif /* __linux__ */
+
+/* A live process only gets a new parent when its parent exits, so a cached
+ * parent pid is used for as long as that parent is still running, as
+ * procparent() does. dwm does not see unrelated processes exit, so the
+ * check is made on every lookup. */
 pid_t
 getparentprocess(pid_t p)
+{
+	ProcEntry *e = &proccache[p & (PROCCACHESIZE - 1)];
+
+	if (procfd >= 0)
+		return procparent(p);
+	if (e->pid != p || (e->ppid > 1 && kill(e->ppid, 0) == -1 && errno == ESRCH)) {
+		e->pid = p;
+		e->ppid = readparentprocess(p);
+	}
+	return e->ppid;
+}
+
+pid_t
+readparentprocess(pid_t p)
 {
 	unsigned int v = 0;
 
@@ -2101,53 +2374,174 @@ gettextprop(Window w, Atom atom, char *text, unsigned int size)
 	return 1;
 }
 
+/* The ClkClientWin bindings are grabbed once on the root window (see
+ * grabrootbuttons), so a client only carries the catch-all grab that makes
+ * a click on it focus it while it is unfocused. */
 void
 grabbuttons(Client *c, int focused)
 {
-	updatenumlockmask();
-	{
-		unsigned int i, j;
-		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+	if (c->grabbed == !focused)
+		return;
+	if (focused)
 		XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
-		if (!focused)
-			XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
-				BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
-		for (i = 0; i < LENGTH(buttons); i++)
-			if (buttons[i].click == ClkClientWin)
-				for (j = 0; j < LENGTH(modifiers); j++)
-					XGrabButton(dpy, buttons[i].button,
-						buttons[i].mask | modifiers[j],
-						c->win, False, BUTTONMASK,
-						GrabModeAsync, GrabModeSync, None, None);
-	}
+	else
+		XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
+			BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
+	c->grabbed = !focused;
+}
+
+void
+grabkey(const KeyGrab *g, int grab)
+{
+	unsigned int j, modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+
+	for (j = 0; j < (numlockmask ? LENGTH(modifiers) : 2); j++)
+		if (grab)
+			XGrabKey(dpy, g->code, g->mod | modifiers[j], root, True,
+				GrabModeAsync, GrabModeAsync);
+		else
+			XUngrabKey(dpy, g->code, g->mod | modifiers[j], root);
 }
 
+/* Grabs are diffed against the last set, so a keymap change only touches
+ * the keycodes that moved. A new numlock modifier changes every grab. */
 void
 grabkeys(void)
 {
-	updatenumlockmask();
 	{
-		unsigned int i, j, k;
-		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
-		int start, end, skip;
+		unsigned int i, j, n = 0, size = LENGTH(keys);
+		int k, start, end, skip, lo, hi, cmp;
 		KeySym *syms;
+		KeyGrab *grabs;
 
-		XUngrabKey(dpy, AnyKey, AnyModifier, root);
+		hashkeys();
 		XDisplayKeycodes(dpy, &start, &end);
 		syms = XGetKeyboardMapping(dpy, start, end - start + 1, &skip);
 		if (!syms)
 			return;
-		for (k = start; k <= end; k++)
-			for (i = 0; i < LENGTH(keys); i++)
-				/* skip modifier codes, we do that ourselves */
-				if (keys[i].keysym == syms[(k - start) * skip])
-					for (j = 0; j < LENGTH(modifiers); j++)
-						XGrabKey(dpy, k,
-							 keys[i].mod | modifiers[j],
-							 root, True,
-							 GrabModeAsync, GrabModeAsync);
+		grabs = ecalloc(size, sizeof(KeyGrab));
+		for (k = start; k <= end; k++) {
+			/* skip modifier codes, we do that ourselves */
+			for (lo = 0, hi = LENGTH(keys); lo < hi;)
+				if (keys[keyorder[(lo + hi) / 2]].keysym < syms[(k - start) * skip])
+					lo = (lo + hi) / 2 + 1;
+				else
+					hi = (lo + hi) / 2;
+			for (i = lo; i < LENGTH(keys) && keys[keyorder[i]].keysym == syms[(k - start) * skip]; i++) {
+				if (n == size && !(grabs = realloc(grabs, (size *= 2) * sizeof(KeyGrab))))
+					die("realloc:");
+				grabs[n].code = k;
+				grabs[n++].mod = keys[keyorder[i]].mod;
+			}
+		}
 		XFree(syms);
+		qsort(grabs, n, sizeof(KeyGrab), keygrabcmp);
+		for (i = j = 0; i < n; i++)
+			if (!j || keygrabcmp(&grabs[j - 1], &grabs[i]))
+				grabs[j++] = grabs[i];
+		n = j;
+
+		if (!keygrabs || keygrabsnumlock != numlockmask) {
+			XUngrabKey(dpy, AnyKey, AnyModifier, root);
+			nkeygrabs = 0;
+		}
+		for (i = j = 0; i < nkeygrabs || j < n;) {
+			cmp = i == nkeygrabs ? 1 : j == n ? -1 : keygrabcmp(&keygrabs[i], &grabs[j]);
+			if (cmp < 0)
+				grabkey(&keygrabs[i++], 0);
+			else if (cmp > 0)
+				grabkey(&grabs[j++], 1);
+			else
+				i++, j++;
+		}
+		free(keygrabs);
+		keygrabs = grabs;
+		nkeygrabs = n;
+		keygrabsnumlock = numlockmask;
+	}
+}
+
+/* A root grab takes precedence over the grabs of the windows below it, so
+ * the bindings work on focused and unfocused clients alike. The pointer is
+ * frozen until buttonpress() either keeps the press or replays it to the
+ * window it was meant for. */
+void
+grabrootbuttons(void)
+{
+	unsigned int i, j, k, n = 0, modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+	struct { unsigned int button, mask; } grabs[LENGTH(buttons)];
+
+	for (i = 0; i < LENGTH(buttons); i++) {
+		if (buttons[i].click != ClkClientWin)
+			continue;
+		for (k = 0; k < n && (grabs[k].button != buttons[i].button || grabs[k].mask != buttons[i].mask); k++);
+		if (k == n) {
+			grabs[n].button = buttons[i].button;
+			grabs[n++].mask = buttons[i].mask;
+		}
+	}
+	XUngrabButton(dpy, AnyButton, AnyModifier, root);
+	for (i = 0; i < n; i++)
+		for (j = 0; j < (numlockmask ? LENGTH(modifiers) : 2); j++)
+			XGrabButton(dpy, grabs[i].button, grabs[i].mask | modifiers[j],
+				root, False, BUTTONMASK, GrabModeSync, GrabModeAsync, None, None);
+}
+
+void
+handlesignal(int sig)
+{
+	switch (sig) {
+	case SIGCHLD:
+		while (waitpid(-1, NULL, WNOHANG) > 0);
+		break;
+	case SIGHUP:
+		quit(&((Arg){.i = EXIT_RESTART}));
+		break;
+	case SIGTERM:
+		quit(NULL);
+		break;
+	case SIGUSR1:
+		statslog();
+		break;
+	case SIGUSR2:
+		tracelog();
+		break;
+	}
+}
+
+/* keys[] indexed by keysym and cleaned mask for keypress(), and by keysym
+ * alone for grabkeys(); both depend on numlockmask */
+void
+hashkeys(void)
+{
+	unsigned int h, i;
+	int last;
+
+	memset(keyhash, 0, sizeof(keyhash));
+	for (i = 0; i < LENGTH(keys); i++) {
+		keymods[i] = CLEANMASK(keys[i].mod);
+		keynext[i] = -1;
+		keyorder[i] = i;
+		h = (keys[i].keysym * 31 + keymods[i]) % LENGTH(keyhash);
+		for (; keyhash[h]; h = (h + 1) % LENGTH(keyhash))
+			if (keys[keyhash[h] - 1].keysym == keys[i].keysym && keymods[keyhash[h] - 1] == keymods[i])
+				break;
+		if (!keyhash[h]) {
+			keyhash[h] = i + 1;
+			continue;
+		}
+		/* same binding twice: chained in keys[] order */
+		for (last = keyhash[h] - 1; keynext[last] >= 0; last = keynext[last]);
+		keynext[last] = i;
 	}
+	qsort(keyorder, LENGTH(keys), sizeof(keyorder[0]), keysymcmp);
+}
+
+unsigned long long
+hashword(unsigned long long h, unsigned long long v)
+{
+	h = (h ^ v) * 0x9e3779b97f4a7c15ULL;
+	return h ^ (h >> 29);
 }
 
 void
@@ -2183,27 +2577,16 @@ hidewin(Client *c) {
 void
 incnmaster(const Arg *arg)
 {
-	char msg[256];
-	const char *cmd[] = { "/usr/bin/dunstify", "-t", "1500", "-r", "50000", "", msg, NULL };
-
 	selmon->nmaster = selmon->pertag->nmasters[selmon->pertag->curtag] = MAX(selmon->nmaster + arg->i, 0);
 	arrange(selmon);
-	snprintf(msg, sizeof msg, "<span font='" NOTIFYFONT "'> Masters: %i \n</span>", selmon->nmaster);
-	spawn(&((Arg){ .v = cmd }));
-}
-
-int
-isdescprocess(pid_t p, pid_t c)
-{
-	while (p != c && c != 0)
-		c = getparentprocess(c);
-
-	return (int)c;
+	osd("Masters: %d", selmon->nmaster);
 }
 
 int
 isprocessrunning(int pid)
 {
+	if (procfd >= 0)
+		return pid > 0 && procrunning(pid);
 	return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
 }
 
@@ -2219,20 +2602,34 @@ isuniquegeom(XineramaScreenInfo *unique, size_t n, XineramaScreenInfo *info)
 }
 #endif /* XINERAMA */
 
+int
+keygrabcmp(const void *a, const void *b)
+{
+	const KeyGrab *x = a, *y = b;
+
+	if (x->code != y->code)
+		return x->code < y->code ? -1 : 1;
+	return (x->mod > y->mod) - (x->mod < y->mod);
+}
+
 void
 keypress(XEvent *e)
 {
-	unsigned int i;
+	int i, timed;
+	StatMark mark;
 	KeySym keysym;
 	XKeyEvent *ev;
 
 	ev = &e->xkey;
 	keysym = XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0);
-	for (i = 0; i < LENGTH(keys); i++)
-		if (keysym == keys[i].keysym
-		&& CLEANMASK(keys[i].mod) == CLEANMASK(ev->state)
-		&& keys[i].func)
+	for (i = findkey(keysym, CLEANMASK(ev->state)); i >= 0; i = keynext[i])
+		if (keys[i].func) {
+			if ((timed = stats))
+				statsbegin(&mark);
 			keys[i].func(&(keys[i].arg));
+			if (timed)
+				statsend(&keystats[i], &mark);
+		}
 }
 
 void
@@ -2244,11 +2641,19 @@ keyrelease(XEvent *e)
 	ev = &e->xkey;
 	if (XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0) == XK_Caps_Lock) {
 		/* signal capslock block */
-		spawn(&((Arg){ .v = (const char*[]){ "sigdsblocks", "9", "1", NULL } }));
+		sigdsblocksqueue(9, 1);
 	}
 #endif
 }
 
+int
+keysymcmp(const void *a, const void *b)
+{
+	KeySym x = keys[*(const unsigned int *)a].keysym, y = keys[*(const unsigned int *)b].keysym;
+
+	return (x > y) - (x < y);
+}
+
 void
 killclient(const Arg *arg)
 {
@@ -2287,21 +2692,66 @@ killscratchpads(void)
 	}
 }
 
+/* collects everything the layouts read in m->key and returns its hash, so
+ * the geometry of a tag can be reused as long as none of it changed */
+unsigned long long
+layoutkey(Monitor *m)
+{
+	unsigned int i, n;
+	int oh, ov, ih, iv;
+	unsigned long long h = 0, *k;
+	Tiled *t;
+	Client *c;
+
+	n = 7 + m->ntiled * (resizehints ? 8 : 3);
+	if (n > m->keysize) {
+		m->keysize = MAX(n, 2 * m->keysize);
+		if (!(m->key = realloc(m->key, m->keysize * sizeof(*m->key))))
+			die("realloc:");
+	}
+	k = m->key;
+	getgaps(m, &oh, &ov, &ih, &iv, &n);
+	*k++ = (uintptr_t)m->lt[m->sellt];
+	*k++ = floatword(m->mfact);
+	*k++ = pairword(m->nmaster, bh);
+	*k++ = pairword(oh, ov);
+	*k++ = pairword(ih, iv);
+	*k++ = pairword(m->wx, m->wy);
+	*k++ = pairword(m->ww, m->wh);
+	for (i = 0; i < m->ntiled; i++) {
+		t = &m->tiled[i];
+		*k++ = (uintptr_t)t->c;
+		*k++ = floatword(t->cfact);
+		*k++ = t->bw;
+		if (resizehints) {
+			c = t->c;
+			*k++ = pairword(c->basew, c->baseh);
+			*k++ = pairword(c->incw, c->inch);
+			*k++ = pairword(c->maxw, c->maxh);
+			*k++ = pairword(c->minw, c->minh);
+			*k++ = (unsigned long long)floatword(c->mina) << 32 | floatword(c->maxa);
+		}
+	}
+	m->nkey = k - m->key;
+	for (k = m->key; k < m->key + m->nkey; k++)
+		h = hashword(h, *k);
+	return h;
+}
+
 void
 layoutmenu(const Arg *arg) {
-	FILE *p;
-	char c[3], *s;
-	int i;
-
-	if (!(p = popen(layoutmenucmd, "r")))
-		 return;
-	s = fgets(c, sizeof(c), p);
-	pclose(p);
+	runcmd(layoutmenucmd, layoutmenudone);
+}
 
-	if (!s || *s == '\0' || *c == '\0')
-		 return;
+void
+layoutmenudone(const char *out)
+{
+	char *end;
+	long i;
 
-	i = atoi(c);
+	i = strtol(out, &end, 10);
+	if (end == out || i < 0 || i >= LENGTH(layouts))
+		return;
 	setlayout(&((Arg) { .v = &layouts[i] }));
 }
 
@@ -2347,6 +2797,25 @@ left_or_master(const Arg *arg)
 	}
 }
 
+/* reuses the geometry stored for the current tag if nothing the layout
+ * depends on changed since it was computed; a matching hash is confirmed
+ * against the stored words */
+int
+loadgeom(Monitor *m)
+{
+	unsigned int i, tag = m->pertag->curtag;
+
+	m->geomkey = layoutkey(m);
+	if (!m->ntiled || m->pertag->ngeoms[tag] != m->ntiled
+	|| m->pertag->geomkeys[tag] != m->geomkey
+	|| m->pertag->nkeys[tag] != m->nkey
+	|| memcmp(m->pertag->keys[tag], m->key, m->nkey * sizeof(*m->key)))
+		return 0;
+	for (i = 0; i < m->ntiled; i++)
+		m->tiled[i].r = m->pertag->geoms[tag][i];
+	return 1;
+}
+
 void
 losefullscreen(Client *next)
 {
@@ -2364,6 +2833,7 @@ manage(Window w, XWindowAttributes *wa)
 	Window trans = None;
 	XWindowChanges wc;
 
+	TRACEBEGIN("manage");
 	c = ecalloc(1, sizeof(Client));
 	c->win = w;
 	c->pid = winpid(w);
@@ -2419,31 +2889,43 @@ manage(Window w, XWindowAttributes *wa)
 	XMoveResizeWindow(dpy, c->win, c->x + 2 * sw, c->y, c->w, c->h); /* some windows require this */
 	if (!HIDDEN(c))
 		setclientstate(c, NormalState);
-	if (c->mon == selmon) {
-		losefullscreen(c);
-		unfocus(selmon->sel, 0);
-	}
-	if (c->mon->hidsel) {
-		hidewin(c->mon->sel);
-		unfocus(c->mon->sel, 0);
-		c->mon->hidsel = 0;
+	/* a window that starts on a hidden tag, like a prewarmed scratchpad,
+	 * leaves focus and fullscreen alone */
+	if (ISVISIBLE(c)) {
+		if (c->mon == selmon) {
+			losefullscreen(c);
+			unfocus(selmon->sel, 0);
+		}
+		if (c->mon->hidsel) {
+			hidewin(c->mon->sel);
+			unfocus(c->mon->sel, 0);
+			c->mon->hidsel = 0;
+		}
+		c->mon->sel = c;
 	}
-	c->mon->sel = c;
+	ipcevent(IpcEvManage, "manage 0x%lx %d %u %s\n", w, c->mon->num, c->tags, c->name);
 	if (!term || !swallow(term, c)) {
 		arrange(c->mon);
 		if (!HIDDEN(c))
 			XMapWindow(dpy, c->win);
 	}
 	focus(NULL);
+	TRACEEND("manage");
 }
 
 void
 mappingnotify(XEvent *e)
 {
 	XMappingEvent *ev = &e->xmapping;
+	unsigned int oldmask = numlockmask;
 
 	XRefreshKeyboardMapping(ev);
-	if (ev->request == MappingKeyboard)
+	if (ev->request == MappingPointer)
+		return;
+	updatenumlockmask();
+	if (numlockmask != oldmask)
+		grabrootbuttons();
+	if (ev->request == MappingKeyboard || numlockmask != oldmask)
 		grabkeys();
 }
 
@@ -2470,16 +2952,12 @@ maprequest(XEvent *e)
 void
 monocle(Monitor *m)
 {
-	int w, h, x, y;
-	Client *c;
-	
-	for (c = nexttiled(m->clients); c; c = nexttiled(c->next)) {
-		x = m->wx;
-		y = m->wy;
-		w = m->ww - 2 * c->bw;
-		h = m->wh - 2 * c->bw;
-		applysizehints(c, &x, &y, &w, &h, 0);
-		resizeclient(c, x, y, w, h);
+	unsigned int i;
+	Tiled *t;
+
+	for (i = 0; i < m->ntiled; i++) {
+		t = &m->tiled[i];
+		placetiled(m, t, m->wx, m->wy, m->ww - 2 * t->bw, m->wh - 2 * t->bw);
 	}
 }
 
@@ -2769,6 +3247,18 @@ moveresizeedge(const Arg *arg) {
 	}
 }
 
+long long
+nexttimer(void)
+{
+	int i;
+	long long t = 0;
+
+	for (i = 0; i < TimerLast; i++)
+		if (timers[i] && (!t || timers[i] < t))
+			t = timers[i];
+	return t;
+}
+
 Client *
 nexttiled(Client *c)
 {
@@ -2783,6 +3273,61 @@ nexttiledall(Client *c)
 	return c;
 }
 
+/* collects the visible tiled clients once per arrange, so the layouts do
+ * not walk the client list (and query the window state) on every pass */
+void
+packtiled(Monitor *m)
+{
+	Client *c;
+
+	m->ntiled = 0;
+	for (c = nexttiled(m->clients); c; c = nexttiled(c->next)) {
+		if (m->ntiled == m->tiledsize) {
+			m->tiledsize = m->tiledsize ? m->tiledsize * 2 : 16;
+			if (!(m->tiled = realloc(m->tiled, m->tiledsize * sizeof(Tiled))))
+				die("realloc:");
+		}
+		if (!c->hintsvalid)
+			updatesizehints(c);
+		m->tiled[m->ntiled].c = c;
+		m->tiled[m->ntiled].cfact = c->cfact;
+		m->tiled[m->ntiled++].bw = c->bw;
+	}
+}
+
+unsigned long long
+pairword(int a, int b)
+{
+	return (unsigned long long)(unsigned int)a << 32 | (unsigned int)b;
+}
+
+/* the arrange-time part of applysizehints(): records where a tiled client
+ * goes without talking to X, so the layouts stay pure */
+void
+placetiled(Monitor *m, Tiled *t, int x, int y, int w, int h)
+{
+	w = MAX(1, w);
+	h = MAX(1, h);
+	if (x >= m->wx + m->ww)
+		x = m->wx + m->ww - (w + 2 * t->bw);
+	if (y >= m->wy + m->wh)
+		y = m->wy + m->wh - (h + 2 * t->bw);
+	if (x + w + 2 * t->bw <= m->wx)
+		x = m->wx;
+	if (y + h + 2 * t->bw <= m->wy)
+		y = m->wy;
+	if (h < bh)
+		h = bh;
+	if (w < bh)
+		w = bh;
+	if (resizehints)
+		applyhints(t->c, &w, &h);
+	t->r.x = x;
+	t->r.y = y;
+	t->r.w = w;
+	t->r.h = h;
+}
+
 void
 pop(Client *c)
 {
@@ -2792,6 +3337,20 @@ pop(Client *c)
 	arrange(c->mon);
 }
 
+/* starts the scratchpads that have no window, hidden, so togglescratch()
+ * only has to show them */
+void
+prewarmscratchpads(void)
+{
+	unsigned int i;
+
+	if (!prewarmscratch)
+		return;
+	for (i = 0; i < LENGTH(scratchpads); i++)
+		if (!scratchclient(i) && getmsec() - scratchstarted[i] >= SCRATCHSTARTTIME)
+			spawnscratch(i);
+}
+
 void
 propertynotify(XEvent *e)
 {
@@ -2810,8 +3369,7 @@ propertynotify(XEvent *e)
 		updatesystray();
 	}
 	if ((ev->window == root) && (ev->atom == XA_WM_NAME)) {
-		if (!fake_signal())
-			updatestatus();
+		updatestatus();
 	}
 	else if (ev->state == PropertyDelete)
 		return; /* ignore */
@@ -2833,6 +3391,7 @@ propertynotify(XEvent *e)
 		}
 		if (ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName]) {
 			updatetitle(c);
+			ipcevent(IpcEvTitle, "title 0x%lx %s\n", c->win, c->name);
 			if (c == c->mon->sel)
 				drawbar(c->mon);
 		}
@@ -2890,6 +3449,57 @@ quit(const Arg *arg)
 	running = 0;
 }
 
+void
+readdsblocks(int fd)
+{
+#if defined(__linux__)
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct inotify_event *ev;
+	ssize_t n;
+	char *p;
+
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		for (p = buf; p < buf + n; p += sizeof(*ev) + ev->len) {
+			ev = (struct inotify_event *)p;
+			if (ev->mask & IN_IGNORED) {
+				/* the directory is gone, look the pid up every time */
+				unwatchfd(fd);
+				close(fd);
+				dsblockswatch = -1;
+				dsblockspid = 0;
+				return;
+			}
+			if (ev->len && !strcmp(ev->name, DSBLOCKSLOCKNAME))
+				dsblockspid = 0;
+		}
+#endif /* __linux__ */
+}
+
+void
+readsignals(int fd)
+{
+#if defined(__linux__)
+	struct signalfd_siginfo si;
+
+	while (read(fd, &si, sizeof(si)) == sizeof(si))
+		handlesignal(si.ssi_signo);
+#else
+	unsigned char sig;
+
+	while (read(fd, &sig, 1) == 1)
+		handlesignal(sig);
+#endif /* __linux__ */
+}
+
+void
+readtimer(int fd)
+{
+	uint64_t expirations;
+
+	if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+		runtimers();
+}
+
 Monitor *
 recttomon(int x, int y, int w, int h)
 {
@@ -2958,6 +3568,32 @@ removeorphanedsystrayicons(void)
 	return rem;
 }
 
+void
+renderbars(void)
+{
+	Monitor *m;
+
+	for (m = mons; m; m = m->next)
+		if (m->bardirty)
+			renderbar(m);
+}
+
+void
+repaint(void)
+{
+	int timed;
+	StatMark mark;
+
+	if (recordfile)
+		recordrepaint();
+	if ((timed = stats))
+		statsbegin(&mark);
+	ipcnotify();
+	renderbars();
+	if (timed)
+		statsend(&renderstats, &mark);
+}
+
 void
 resize(Client *c, int x, int y, int w, int h, int interact)
 {
@@ -3093,8 +3729,13 @@ restack(Monitor *m)
 	XWindowChanges wc;
 
 	drawbar(m);
+	if (batch) {
+		m->restackdirty = 1;
+		return;
+	}
 	if (!m->sel)
 		return;
+	TRACEBEGIN("restack");
 	if (m->sel->isfloating || !m->lt[m->sellt]->arrange)
 		XRaiseWindow(dpy, m->sel->win);
 	if (m->lt[m->sellt]->arrange) {
@@ -3108,6 +3749,7 @@ restack(Monitor *m)
 	}
 	XSync(dpy, False);
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
+	TRACEEND("restack");
 }
 
 /**
@@ -3158,9 +3800,104 @@ run(void)
 	XEvent ev;
 	/* main event loop */
 	XSync(dpy, False);
-	while (running && !XNextEvent(dpy, &ev))
-		if (handler[ev.type])
-			handler[ev.type](&ev); /* call handler */
+	while (running) {
+		while (running && XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			dispatch(&ev);
+		}
+		if (!running)
+			break;
+		/* bars and subscribers are only updated once all pending events
+		 * are handled, so a burst of events costs one repaint and input
+		 * is never queued behind it */
+		repaint();
+		/* painting syncs with the server and may have queued new events */
+		if (!XPending(dpy))
+			waitevents();
+	}
+}
+
+/* Runs cmd with sh -c and hands its output to done from the event loop, so
+ * dwm keeps handling events while a menu is open. */
+void
+runcmd(const char *cmd, void (*done)(const char *out))
+{
+	char *argv[] = { "/bin/sh", "-c", (char *)cmd, NULL };
+	posix_spawn_file_actions_t fa;
+	int fds[2];
+	pid_t pid;
+	Cmd *c;
+
+	if (pipe(fds) == -1)
+		return;
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	posix_spawn_file_actions_init(&fa);
+	if (fds[1] != STDOUT_FILENO) {
+		posix_spawn_file_actions_adddup2(&fa, fds[1], STDOUT_FILENO);
+		posix_spawn_file_actions_addclose(&fa, fds[1]);
+	}
+	pid = spawnproc(argv, &fa);
+	posix_spawn_file_actions_destroy(&fa);
+	close(fds[1]);
+	if (pid == -1) {
+		close(fds[0]);
+		return;
+	}
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	c = ecalloc(1, sizeof(Cmd));
+	c->fd = fds[0];
+	c->done = done;
+	c->next = cmds;
+	cmds = c;
+	watchfd(c->fd, WatchCmd);
+}
+
+void
+runtimers(void)
+{
+	int i;
+	long long now = getmsec();
+
+	for (i = 0; i < TimerLast; i++)
+		if (timers[i] && timers[i] <= now) {
+			timers[i] = 0;
+			timerhandler[i]();
+		}
+	armtimers();
+}
+
+void
+savegeom(Monitor *m)
+{
+	unsigned int i, tag = m->pertag->curtag;
+
+	if (m->pertag->ngeoms[tag] != m->ntiled) {
+		free(m->pertag->geoms[tag]);
+		m->pertag->geoms[tag] = ecalloc(MAX(m->ntiled, 1), sizeof(Rect));
+		m->pertag->ngeoms[tag] = m->ntiled;
+	}
+	for (i = 0; i < m->ntiled; i++)
+		m->pertag->geoms[tag][i] = m->tiled[i].r;
+	if (m->pertag->nkeys[tag] != m->nkey) {
+		free(m->pertag->keys[tag]);
+		m->pertag->keys[tag] = ecalloc(m->nkey, sizeof(*m->key));
+		m->pertag->nkeys[tag] = m->nkey;
+	}
+	memcpy(m->pertag->keys[tag], m->key, m->nkey * sizeof(*m->key));
+	m->pertag->geomkeys[tag] = m->geomkey;
+}
+
+Client *
+scratchclient(unsigned int i)
+{
+	Client *c;
+	Monitor *m;
+
+	for (m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next)
+			if (c->tags & SPTAG(i))
+				return c;
+	return NULL;
 }
 
 void
@@ -3403,6 +4140,7 @@ setlayout(const Arg *arg)
 		arrange(selmon);
 	else
 		drawbar(selmon);
+	osd("Layout: %s", selmon->ltsymbol);
 }
 
 void
@@ -3426,6 +4164,7 @@ setcfact(const Arg *arg) {
 		f = 4.0;
 	c->cfact = f;
 	arrange(selmon);
+	osd("cfact: %.2f", f);
 }
 
 /* arg > 1.0 will set mfact absolutely */
@@ -3441,34 +4180,21 @@ setmfact(const Arg *arg)
 		return;
 	selmon->mfact = selmon->pertag->mfacts[selmon->pertag->curtag] = f;
 	arrange(selmon);
+	osd("mfact: %.2f", f);
 }
 
 void
 setsystraytimer(void)
 {
-	struct sigaction sa;
-	struct timespec t = { .tv_sec = 1, .tv_nsec = 0 };
-	char *refreshcmd[] = { "xsetroot", "-name", "fsignal:refreshsystray", NULL };
-
-	if (systraytimer)
-		return;
-
-	systraytimer = 1;
-
-	if (fork() == 0) {
-		if (dpy)
-			close(ConnectionNumber(dpy));
-		setsid();
-
-		sigemptyset(&sa.sa_mask);
-		sa.sa_flags = 0;
-		sa.sa_handler = SIG_DFL;
-		sigaction(SIGCHLD, &sa, NULL);
+	if (!timers[TimerSystray])
+		settimer(TimerSystray, 1000);
+}
 
-		while (nanosleep(&t, &t) == -1);
-		execvp(refreshcmd[0], refreshcmd);
-		_exit(1);
-	}
+void
+settimer(int id, int ms)
+{
+	timers[id] = ms < 0 ? 0 : getmsec() + ms;
+	armtimers();
 }
 
 void
@@ -3477,19 +4203,73 @@ setup(void)
 	int i;
 	XSetWindowAttributes wa;
 	Atom utf8string;
+	sigset_t sigs;
 	struct sigaction sa;
 
-	/* do not transform children into zombies when they terminate */
+	/* the one line of bloat that would have saved a lot of time for a lot of people */
+	putenv("_JAVA_AWT_WM_NONREPARENTING=1");
+
+	/* an IPC client that hangs up before reading its reply must not kill
+	 * dwm; spawnproc() restores SIGPIPE for the commands */
 	sigemptyset(&sa.sa_mask);
-	sa.sa_flags = SA_NOCLDSTOP | SA_NOCLDWAIT | SA_RESTART;
+	sa.sa_flags = 0;
 	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+
+	/* SIGCHLD, SIGTERM, SIGHUP, SIGUSR1 and SIGUSR2 are handled from the event loop */
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGCHLD);
+	sigaddset(&sigs, SIGTERM);
+	sigaddset(&sigs, SIGHUP);
+	sigaddset(&sigs, SIGUSR1);
+	sigaddset(&sigs, SIGUSR2);
+#if defined(__linux__)
+	sigprocmask(SIG_BLOCK, &sigs, &origsigmask);
+	if ((epollfd = epoll_create1(EPOLL_CLOEXEC)) == -1
+	|| (timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1
+	|| (sigfd[0] = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC)) == -1)
+		die("dwm: cannot set up event loop:");
+	watchfd(timerfd, WatchTimer);
+#else
+	sigprocmask(SIG_BLOCK, NULL, &origsigmask);
+	if (pipe(sigfd) == -1)
+		die("dwm: pipe:");
+	for (i = 0; i < 2; i++) {
+		fcntl(sigfd[i], F_SETFD, FD_CLOEXEC);
+		fcntl(sigfd[i], F_SETFL, O_NONBLOCK);
+	}
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_NOCLDSTOP | SA_RESTART;
+	sa.sa_handler = sigforward;
 	sigaction(SIGCHLD, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+	sigaction(SIGUSR1, &sa, NULL);
+	sigaction(SIGUSR2, &sa, NULL);
+#endif /* __linux__ */
+	watchfd(sigfd[0], WatchSignal);
+	fcntl(ConnectionNumber(dpy), F_SETFD, FD_CLOEXEC);
+	watchfd(ConnectionNumber(dpy), WatchX);
+#if defined(__linux__)
+	if ((dsblockswatch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) != -1) {
+		if (inotify_add_watch(dsblockswatch, DSBLOCKSLOCKDIR,
+				IN_OPEN | IN_CLOSE | IN_CREATE | IN_DELETE | IN_MOVE) != -1)
+			watchfd(dsblockswatch, WatchDsblocks);
+		else {
+			close(dsblockswatch);
+			dsblockswatch = -1;
+		}
+	}
+#endif /* __linux__ */
+	ipcsetup();
+	spawnsetup(); /* after ipcsetup() so the commands get DWM_SOCKET */
+	procsetup();
+	rulescompile();
+	stats = statsenabled;
+	traceenable(traceenabled);
 
 	/* clean up any zombies (inherited from .xinitrc etc) immediately */
-	while (waitpid(-1, NULL, WNOHANG) > 0);
-
-	/* the one line of bloat that would have saved a lot of time for a lot of people */
-	putenv("_JAVA_AWT_WM_NONREPARENTING=1");
+	handlesignal(SIGCHLD);
 
 	/* init screen */
 	screen = DefaultScreen(dpy);
@@ -3501,6 +4281,7 @@ setup(void)
 		die("no fonts could be loaded.");
 	lrpad = drw->fonts->h;
 	bh = user_bh ? user_bh : drw->fonts->h + 2;
+	osdsetup();
 	updategeom();
 	/* init atoms */
 	utf8string = XInternAtom(dpy, "UTF8_STRING", False);
@@ -3562,8 +4343,11 @@ setup(void)
 		|LeaveWindowMask|StructureNotifyMask|PropertyChangeMask;
 	XChangeWindowAttributes(dpy, root, CWEventMask|CWCursor, &wa);
 	XSelectInput(dpy, root, wa.event_mask);
+	updatenumlockmask();
 	grabkeys();
+	grabrootbuttons();
 	focus(NULL);
+	renderstart();
 }
 
 void
@@ -3655,35 +4439,35 @@ showhide(Client *c)
 
 void
 sigdsblocks(const Arg *arg)
+{
+	if (dsblockssig)
+		sigdsblocksqueue(0, (dsblockssig << 8) | arg->i);
+}
+
+/* what sigdsblocks does for "sigdsblocks <signal> <value>": the value goes
+ * to the block on SIGRTMIN+signal */
+void
+sigdsblocksqueue(int sig, int value)
 {
 #if defined(__linux__)
-	static int fd = -1;
-	struct flock fl;
-	union sigval sv;
+	union sigval sv = { .sival_int = value };
+	pid_t pid;
 
-	if (!dsblockssig)
+	if ((pid = getdsblockspid()) <= 0)
 		return;
-	fl.l_type = F_WRLCK;
-	fl.l_whence = SEEK_SET;
-	fl.l_start = 0;
-	fl.l_len = 0;
-	if (fd != -1) {
-		if (fcntl(fd, F_GETLK, &fl) != -1 && fl.l_type == F_WRLCK)
-			goto signal;
-		close(fd);
-		fl.l_type = F_WRLCK;
+	if (sigqueue(pid, SIGRTMIN + sig, sv) == -1 && errno == ESRCH) {
+		dsblockspid = 0;
+		if ((pid = getdsblockspid()) > 0)
+			sigqueue(pid, SIGRTMIN + sig, sv);
 	}
-	if ((fd = open(DSBLOCKSLOCKFILE, O_RDONLY | O_CLOEXEC)) == -1)
-		return;
-	if (fcntl(fd, F_GETLK, &fl) == -1 || fl.l_type != F_WRLCK) {
-		close(fd);
-		fd = -1;
-		return;
-	}
-signal:
-	sv.sival_int = (dsblockssig << 8) | arg->i;
-	sigqueue(fl.l_pid, SIGRTMIN, sv);
-#endif
+#endif /* __linux__ */
+}
+
+/* arg->v is { signal, value } */
+void
+sigdsblocksval(const Arg *arg)
+{
+	sigdsblocksqueue(((const int *)arg->v)[0], ((const int *)arg->v)[1]);
 }
 
 int
@@ -3706,6 +4490,9 @@ swallow(Client *p, Client *c)
 	Window w = p->win;
 	p->win = c->win;
 	c->win = w;
+	int grabbed = p->grabbed;
+	p->grabbed = c->grabbed;
+	c->grabbed = grabbed;
 
 	#if SHOWWINICON
 	Window icon = p->icon;
@@ -3747,26 +4534,33 @@ swallowingclient(Window w)
 	return NULL;
 }
 
+#if !defined(__linux__)
 void
-spawn(const Arg *arg)
+sigforward(int sig)
 {
-	struct sigaction sa;
+	int e = errno;
+	unsigned char c = sig;
+
+	/* handled from the event loop, see readsignals() */
+	if (write(sigfd[1], &c, 1) == -1) {}
+	errno = e;
+}
+#endif /* __linux__ */
 
+void
+spawn(const Arg *arg)
+{
 	if (arg->v == dmenucmd)
 		dmenumon[0] = '0' + selmon->num;
-	if (fork() == 0) {
-		if (dpy)
-			close(ConnectionNumber(dpy));
-		setsid();
-
-		sigemptyset(&sa.sa_mask);
-		sa.sa_flags = 0;
-		sa.sa_handler = SIG_DFL;
-		sigaction(SIGCHLD, &sa, NULL);
+	if (!spawnlaunch((char *const *)arg->v))
+		spawnproc((char *const *)arg->v, NULL);
+}
 
-		execvp(((char **)arg->v)[0], (char **)arg->v);
-		die("dwm: execvp '%s' failed:", ((char **)arg->v)[0]);
-	}
+void
+spawnscratch(unsigned int i)
+{
+	scratchstarted[i] = getmsec();
+	spawn(&((Arg){ .v = scratchpads[i].cmd }));
 }
 
 int
@@ -3848,20 +4642,35 @@ tagmon(const Arg *arg)
 		sendmon(c, dirtomon(arg->i));
 }
 
+/* The nearest ancestor of the window's process that is a terminal client.
+ * Terminal pids are folded into a 64-bit filter first, so the walk up the
+ * tree reads each ancestor once and only looks at the clients on a hit. */
 Client *
 termforwin(const Client *w)
 {
+	unsigned long long terms = 0;
+	int depth;
+	pid_t p;
 	Client *c;
 	Monitor *m;
 
 	if (!w->pid || w->isterminal)
 		return NULL;
 
-	for (m = mons; m; m = m->next) {
-		for (c = m->clients; c; c = c->next) {
-			if (c->isterminal && !c->swallowing && c->pid && isdescprocess(c->pid, w->pid))
-				return c;
-		}
+	for (m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next)
+			if (c->isterminal && !c->swallowing && c->pid)
+				terms |= 1ULL << (c->pid & 63);
+	if (!terms)
+		return NULL;
+
+	for (p = w->pid, depth = 0; p > 0 && depth < PROCMAXDEPTH; p = getparentprocess(p), depth++) {
+		if (!(terms & 1ULL << (p & 63)))
+			continue;
+		for (m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next)
+				if (c->isterminal && !c->swallowing && c->pid == p)
+					return c;
 	}
 
 	return NULL;
@@ -3992,7 +4801,6 @@ togglescratch(const Arg *arg)
 	Client *c;
 	unsigned int found = 0;
 	unsigned int scratchtag = SPTAG(arg->ui);
-	Arg sparg = {.v = scratchpads[arg->ui].cmd};
 
 	for (c = selmon->clients; c && !(found = c->tags & scratchtag); c = c->next);
 	if (found) {
@@ -4008,7 +4816,9 @@ togglescratch(const Arg *arg)
 		}
 	} else {
 		selmon->tagset[selmon->seltags] |= scratchtag;
-		spawn(&sparg);
+		/* one that is still starting shows up on the tag by itself */
+		if (getmsec() - scratchstarted[arg->ui] >= SCRATCHSTARTTIME)
+			spawnscratch(arg->ui);
 	}
 }
 
@@ -4157,12 +4967,15 @@ unfocus(Client *c, int setfocus)
 void
 unmanage(Client *c, int destroyed)
 {
-	Monitor *m = c->mon;
-	unsigned int switchtag = c->switchtag;
+	Monitor *m = c->mon, *sm;
+	unsigned int i, switchtag = c->switchtag;
 	XWindowChanges wc;
 
+	ipcevent(IpcEvUnmanage, "unmanage 0x%lx\n", c->win);
+	TRACEBEGIN("unmanage");
 	if (c->swallowing) {
 		unswallow(c);
+		TRACEEND("unmanage");
 		return;
 	}
 
@@ -4175,6 +4988,7 @@ unmanage(Client *c, int destroyed)
 		s->swallowing = NULL;
 		arrange(m);
 		focus(NULL);
+		TRACEEND("unmanage");
 		return;
 	}
 
@@ -4185,6 +4999,16 @@ unmanage(Client *c, int destroyed)
 	#if SHOWWINICON
 	freeicon(c);
 	#endif
+	/* an exited scratchpad is started again, hidden, unless it did not
+	 * last long enough to be worth it */
+	for (i = 0; running && prewarmscratch && i < LENGTH(scratchpads); i++)
+		if ((c->tags & SPTAG(i)) && !scratchclient(i)
+		&& getmsec() - scratchstarted[i] >= SCRATCHSTARTTIME) {
+			for (sm = mons; sm; sm = sm->next)
+				if (sm->tagset[sm->seltags] & ~SPTAG(i))
+					sm->tagset[sm->seltags] &= ~SPTAG(i);
+			settimer(TimerScratch, SCRATCHRESPAWNDELAY);
+		}
 	if (!destroyed) {
 		wc.border_width = c->oldbw;
 		XGrabServer(dpy); /* avoid race conditions */
@@ -4203,6 +5027,7 @@ unmanage(Client *c, int destroyed)
 	arrange(m);
 	if (switchtag)
 		view(&((Arg) { .ui = switchtag }));
+	TRACEEND("unmanage");
 }
 
 void
@@ -4229,6 +5054,7 @@ void
 unswallow(Client *c)
 {
 	c->win = c->swallowing->win;
+	c->grabbed = c->swallowing->grabbed;
 
 	#if SHOWWINICON
 	freeicon(c);
@@ -4283,6 +5109,22 @@ updatebars(void)
 	}
 }
 
+void
+unwatchfd(int fd)
+{
+#if defined(__linux__)
+	epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, NULL);
+#else
+	int i;
+
+	for (i = 0; i < nwatches && watches[i].fd != fd; i++);
+	if (i < nwatches) {
+		watches[i] = watches[--nwatches];
+		watchtypes[i] = watchtypes[nwatches];
+	}
+#endif /* __linux__ */
+}
+
 void
 updatebarpos(Monitor *m)
 {
@@ -4315,7 +5157,9 @@ void
 updateicon(Client *c)
 {
 	freeicon(c);
+	TRACEBEGIN("geticonprop");
 	c->icon = geticonprop(c->win, &c->icw, &c->ich);
+	TRACEEND("geticonprop");
 }
 #endif
 
@@ -4742,11 +5586,84 @@ view(const Arg *arg)
 	arrange(selmon);
 }
 
+void
+waitevents(void)
+{
+	int i, n;
+#if defined(__linux__)
+	struct epoll_event ev[16];
+
+	if ((n = epoll_wait(epollfd, ev, LENGTH(ev), -1)) == -1 && errno != EINTR)
+		die("dwm: epoll_wait:");
+	for (i = 0; i < n; i++)
+		if (watchhandler[ev[i].data.u64 >> 32])
+			watchhandler[ev[i].data.u64 >> 32]((int)(ev[i].data.u64 & 0xffffffff));
+#else
+	long long t;
+	int timeout = -1;
+
+	if ((t = nexttimer()))
+		timeout = MAX(t - getmsec(), 0);
+	if ((n = poll(watches, nwatches, timeout)) == -1 && errno != EINTR)
+		die("dwm: poll:");
+	/* walk backwards, handlers may unwatch their own fd */
+	for (i = nwatches - 1; i >= 0 && n > 0; i--)
+		if (watches[i].revents) {
+			n--;
+			if (watchhandler[watchtypes[i]])
+				watchhandler[watchtypes[i]](watches[i].fd);
+		}
+	runtimers();
+#endif /* __linux__ */
+}
+
+void
+watchfd(int fd, int type)
+{
+#if defined(__linux__)
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.u64 = (uint64_t)type << 32 | (uint32_t)fd,
+	};
+
+	if (epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+		die("dwm: epoll_ctl:");
+#else
+	if (nwatches == LENGTH(watches))
+		die("dwm: too many watched fds");
+	watches[nwatches].fd = fd;
+	watches[nwatches].events = POLLIN;
+	watchtypes[nwatches++] = type;
+#endif /* __linux__ */
+}
+
+void
+watchfdwrite(int fd, int type, int enable)
+{
+#if defined(__linux__)
+	struct epoll_event ev = {
+		.events = EPOLLIN | (enable ? EPOLLOUT : 0),
+		.data.u64 = (uint64_t)type << 32 | (uint32_t)fd,
+	};
+
+	epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &ev);
+#else
+	int i;
+
+	for (i = 0; i < nwatches && watches[i].fd != fd; i++);
+	if (i < nwatches)
+		watches[i].events = POLLIN | (enable ? POLLOUT : 0);
+#endif /* __linux__ */
+}
+
 pid_t
 winpid(Window w)
 {
 	pid_t result = 0;
 
+	if (replaying)
+		return replaypid(w);
+
 #if defined(__linux__)
 	xcb_res_client_id_spec_t spec = {0};
 	spec.client = w;
@@ -4842,6 +5759,9 @@ wintomon(Window w)
 int
 xerror(Display *dpy, XErrorEvent *ee)
 {
+	/* bars and icons may be gone by the time the render thread draws them */
+	if (dpy == renderdpy)
+		return 0;
 	if (ee->error_code == BadWindow
 	|| (ee->request_code == X_SetInputFocus && ee->error_code == BadMatch)
 	|| (ee->request_code == X_PolyText8 && ee->error_code == BadDrawable)
@@ -4944,10 +5864,20 @@ zoomswap(const Arg *arg)
 int
 main(int argc, char *argv[])
 {
+	const char *recordpath = NULL, *replaypath = NULL;
+
 	if (argc == 2 && !strcmp("-v", argv[1]))
 		die("dwm-"VERSION);
+	else if (argc > 2 && !strcmp("-c", argv[1]))
+		return ipcsend(argc - 2, argv + 2);
+	else if (argc == 3 && !strcmp("-r", argv[1]))
+		recordpath = argv[2];
+	else if (argc == 3 && !strcmp("-p", argv[1]))
+		replaypath = argv[2];
 	else if (argc != 1)
-		die("usage: dwm [-v]");
+		die("usage: dwm [-v] [-c command [type value]] [-r file | -p file]");
+	if (renderthread && !XInitThreads())
+		die("dwm: cannot initialize xlib threads");
 	if (!setlocale(LC_CTYPE, "") || !XSupportsLocale())
 		fputs("warning: no locale support\n", stderr);
 	if (!(dpy = XOpenDisplay(NULL)))
@@ -4957,11 +5887,19 @@ main(int argc, char *argv[])
 	checkotherwm();
 	setup();
 #ifdef __OpenBSD__
-	if (pledge("stdio rpath proc exec ps", NULL) == -1)
+	/* unix: accept() on the ipc socket; wpath cpath: dwm -r, "record start"
+	 * and "trace write" create files after this point */
+	if (pledge("stdio rpath wpath cpath unix proc exec ps", NULL) == -1)
 		die("pledge");
 #endif /* __OpenBSD__ */
+	if (recordpath && !recordstart(recordpath))
+		die("dwm: cannot record to '%s':", recordpath);
 	scan();
-	run();
+	if (!replaypath) {
+		prewarmscratchpads();
+		run();
+	} else if (!replay(replaypath))
+		exitcode = EXIT_FAILURE;
 	killscratchpads();
 	cleanup();
 	XCloseDisplay(dpy);
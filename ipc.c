@@ -0,0 +1,939 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Unix domain socket for controlling dwm from scripts. Every line written to
+ * the socket is a command of the form
+ *
+ *     <name> [<type> <value>]
+ *
+ * where name is an entry of signals[] in config.h and type is one of i, ui,
+ * f or s (the rest of the line). Every command is answered with a line
+ * containing either "ok" or "error <reason>". Use `dwm -c <command>` to send
+ * a single command from the shell.
+ *
+ * "subscribe [<event>...]" turns the connection into an event stream. Events
+ * are focus, tags, layout, manage, unmanage and title (all by default) and
+ * are written as lines:
+ *
+ *     focus <mon> <win>
+ *     tags <mon> <viewed> <occupied> <urgent>
+ *     layout <mon> <index> <mfact> <nmaster> <symbol>
+ *     manage <win> <mon> <tags> <title>
+ *     unmanage <win>
+ *     title <win> <title>
+ *
+ * The focus, tags and layout state is sent once right after subscribing.
+ * Every connection has a bounded output queue; a subscriber that falls
+ * behind by more than IPCQUEUESIZE bytes is disconnected.
+ *
+ * "batch <command>; <command>; ..." runs the commands as one transaction:
+ * arranging, restacking and bar updates are held back until the last one
+ * has run, so the screen changes once. Arguments cannot contain ';'. The
+ * batch stops at the first failing command and the error names its
+ * position; the commands before it stay applied.
+ *
+ * "stats [on|off|reset]" controls the event loop statistics; see stats.c.
+ * "trace on|off|write [<path>]" controls activity tracing; see trace.c.
+ * "record start <path>|stop" records the events dwm handles; see record.c.
+ *
+ * "state [json|binary]" returns a snapshot of all monitors, their pertag
+ * settings and all clients, built directly from the in-memory structures.
+ * The reply is "ok <length>" followed by length bytes. The binary encoding
+ * is a sequence of native-endian 32-bit fields (f32 for floats):
+ *
+ *     magic 0x53574d44 ("DWMS"), version 1, ntags, selmon, nmons, then
+ *     for each monitor:
+ *         num, mx, my, mw, mh, wx, wy, ww, wh, showbar, topbar, tagset[2],
+ *         seltags, layout[2], sellt, attach[2], selatt, f32 mfact, nmaster,
+ *         gappih, gappiv, gappoh, gappov, sel, curtag, prevtag,
+ *         ntags + 1 times: nmaster, f32 mfact, sellt, layout[2], showbar,
+ *             selatt, attach[2], enablegaps, gaps, prevzoom,
+ *         nclients, for each client: win, tags, flags, noswallow,
+ *             swallowing, x, y, w, h, bw, pid, f32 cfact, namelen, name
+ *             (namelen bytes, no terminator),
+ *         nstack, the windows in focus order
+ *
+ * Layouts and attach positions are indices into layouts[] and attachs[],
+ * clients are window ids and flags are the IPCF* bits below.
+ */
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define IPCLINESIZE  4096
+#define IPCQUEUESIZE (256 * 1024)
+#define IPCSTATEMAGIC 0x53574d44
+#ifdef MSG_NOSIGNAL
+#define IPCSENDFLAGS MSG_NOSIGNAL /* setup() ignores SIGPIPE elsewhere */
+#else
+#define IPCSENDFLAGS 0
+#endif
+
+enum { IPCFFloating = 1 << 0, IPCFFullscreen = 1 << 1, IPCFFakeFullscreen = 1 << 2,
+       IPCFSticky = 1 << 3, IPCFUrgent = 1 << 4, IPCFNeverFocus = 1 << 5,
+       IPCFFixed = 1 << 6, IPCFTerminal = 1 << 7 }; /* client flags in state */
+
+enum { IpcEvFocus, IpcEvTags, IpcEvLayout, IpcEvManage, IpcEvUnmanage,
+       IpcEvTitle, IpcEvLast }; /* subscribable events */
+
+typedef struct IpcClient IpcClient;
+struct IpcClient {
+	int fd;
+	unsigned int events; /* subscribed events */
+	int fresh;           /* needs the current state on the next notify */
+	size_t inlen;
+	char in[IPCLINESIZE];
+	char *out;           /* queued output */
+	size_t outlen, outsize;
+	int pollout;         /* waiting for the socket to become writable */
+	int dead;            /* dropped while its commands ran, see ipcclose() */
+	IpcClient *next;
+};
+
+typedef struct {
+	char *data;
+	size_t len, size;
+} IpcBuf;
+
+typedef struct {
+	unsigned int tagset, occ, urg;
+	int nmaster;
+	float mfact;
+	char ltsymbol[16];
+	const Layout *lt;
+} IpcMonState;
+
+static int ipcappend(IpcClient *c, const char *buf, size_t len);
+static int ipcbatch(char *cmds, const char **err);
+static void ipcbufjsonstr(IpcBuf *b, const char *str);
+static void ipcbufprintf(IpcBuf *b, const char *fmt, ...);
+static void ipcbufput(IpcBuf *b, const void *data, size_t len);
+static void ipcbufu32(IpcBuf *b, uint32_t v);
+static void ipcclose(IpcClient *c);
+static int ipcexec(char *cmd, const char **err);
+static int ipcflush(IpcClient *c);
+static int ipcrecord(char *args, const char **err);
+static int ipcreply(IpcClient *c, const char *fmt, ...);
+static int ipcsocketpath(char *buf, size_t size);
+static int ipcstate(IpcClient *c, char *args, const char **err);
+static void ipcstatebinary(IpcBuf *b);
+static void ipcstatejson(IpcBuf *b);
+static int ipcstats(IpcClient *c, char *args, const char **err);
+static int ipcsubscribe(IpcClient *c, char *args, const char **err);
+static Window ipcwin(Monitor *m, Client *c);
+static int ipctrace(char *args, const char **err);
+static int recordstart(const char *path);
+static int recordstop(void);
+static void statsdump(IpcBuf *b);
+static void statsreset(void);
+static void traceenable(int on);
+static int tracewrite(const char *path);
+
+static const char *ipcevnames[IpcEvLast] = {
+	[IpcEvFocus] = "focus",
+	[IpcEvTags] = "tags",
+	[IpcEvLayout] = "layout",
+	[IpcEvManage] = "manage",
+	[IpcEvUnmanage] = "unmanage",
+	[IpcEvTitle] = "title",
+};
+static int ipcfd = -1;
+static char ipcsockpath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static IpcClient *ipcclients;
+static IpcClient *ipcreading;       /* the client ipcread() runs commands for */
+static unsigned int ipcsubscribed;  /* union of all subscribed events */
+static IpcMonState *ipcmonstate;    /* last published state, by monitor number */
+static int ipcnmonstate;
+static Window ipcfocus;
+static int ipcfocusmon = -1;
+
+void
+ipcaccept(int fd)
+{
+	int cfd;
+	IpcClient *c;
+
+	while ((cfd = accept(fd, NULL, NULL)) != -1) {
+		fcntl(cfd, F_SETFD, FD_CLOEXEC);
+		fcntl(cfd, F_SETFL, O_NONBLOCK);
+		c = ecalloc(1, sizeof(IpcClient));
+		c->fd = cfd;
+		c->next = ipcclients;
+		ipcclients = c;
+		watchfd(cfd, WatchIpcClient);
+	}
+}
+
+int
+ipcappend(IpcClient *c, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	if (c->dead)
+		return 0;
+	/* skip the queue when it is empty and the socket takes it all */
+	if (!c->outlen) {
+		while ((n = send(c->fd, buf, len, IPCSENDFLAGS)) == -1 && errno == EINTR);
+		if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			ipcclose(c);
+			return 0;
+		}
+		if (n > 0) {
+			buf += n;
+			len -= n;
+		}
+		if (!len)
+			return 1;
+	}
+	if (c->outlen + len > IPCQUEUESIZE) {
+		ipcclose(c);
+		return 0;
+	}
+	if (c->outlen + len > c->outsize) {
+		c->outsize = MAX(c->outsize * 2, c->outlen + len);
+		if (!(c->out = realloc(c->out, c->outsize)))
+			die("realloc:");
+	}
+	memcpy(c->out + c->outlen, buf, len);
+	c->outlen += len;
+	return ipcflush(c);
+}
+
+int
+ipcbatch(char *cmds, const char **err)
+{
+	static char errbuf[128];
+	char *cmd, *next;
+	int i, ret = 1;
+
+	batch = 1;
+	for (i = 1, cmd = cmds; cmd; cmd = next, i++) {
+		if ((next = strchr(cmd, ';')))
+			*next++ = '\0';
+		if (!cmd[strspn(cmd, " \t")])
+			continue;
+		if (!ipcexec(cmd, err)) {
+			snprintf(errbuf, sizeof(errbuf), "command %d: %s", i, *err);
+			*err = errbuf;
+			ret = 0;
+			break;
+		}
+	}
+	commitbatch();
+	return ret;
+}
+
+void
+ipcbufjsonstr(IpcBuf *b, const char *str)
+{
+	const char *p;
+
+	ipcbufput(b, "\"", 1);
+	for (p = str; *p; p++) {
+		if (*p == '"' || *p == '\\') {
+			ipcbufput(b, str, p - str);
+			ipcbufprintf(b, "\\%c", *p);
+			str = p + 1;
+		} else if ((unsigned char)*p < 0x20) {
+			ipcbufput(b, str, p - str);
+			ipcbufprintf(b, "\\u%04x", *p);
+			str = p + 1;
+		}
+	}
+	ipcbufput(b, str, p - str);
+	ipcbufput(b, "\"", 1);
+}
+
+void
+ipcbufprintf(IpcBuf *b, const char *fmt, ...)
+{
+	int len;
+	va_list ap;
+
+	va_start(ap, fmt);
+	len = vsnprintf(b->data + b->len, b->size - b->len, fmt, ap);
+	va_end(ap);
+	if (len < 0)
+		return;
+	if ((size_t)len >= b->size - b->len) {
+		ipcbufput(b, NULL, len + 1);
+		b->len -= len + 1;
+		va_start(ap, fmt);
+		vsnprintf(b->data + b->len, b->size - b->len, fmt, ap);
+		va_end(ap);
+	}
+	b->len += len;
+}
+
+/* appends len bytes of data, or reserves them when data is NULL */
+void
+ipcbufput(IpcBuf *b, const void *data, size_t len)
+{
+	if (b->len + len > b->size) {
+		b->size = MAX(b->size * 2, MAX(b->len + len, 4096));
+		if (!(b->data = realloc(b->data, b->size)))
+			die("realloc:");
+	}
+	if (data)
+		memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+void
+ipcbufu32(IpcBuf *b, uint32_t v)
+{
+	ipcbufput(b, &v, sizeof(v));
+}
+
+void
+ipccleanup(void)
+{
+	while (ipcclients)
+		ipcclose(ipcclients);
+	if (ipcfd == -1)
+		return;
+	unwatchfd(ipcfd);
+	close(ipcfd);
+	unlink(ipcsockpath);
+	ipcfd = -1;
+}
+
+/* a command can drop the client that sent it, e.g. when the event it
+ * causes does not fit the queue; that client is only marked dead here and
+ * ipcread() frees it once the command has returned */
+void
+ipcclose(IpcClient *c)
+{
+	IpcClient **cc;
+
+	if (c == ipcreading) {
+		c->dead = 1;
+		c->events = 0;
+	} else {
+		for (cc = &ipcclients; *cc && *cc != c; cc = &(*cc)->next);
+		if (*cc)
+			*cc = c->next;
+		unwatchfd(c->fd);
+		close(c->fd);
+		free(c->out);
+		free(c);
+	}
+	for (ipcsubscribed = 0, c = ipcclients; c; c = c->next)
+		ipcsubscribed |= c->events;
+}
+
+/* writes an event line to every subscriber of ev */
+void
+ipcevent(int ev, const char *fmt, ...)
+{
+	char buf[IPCLINESIZE];
+	int len;
+	va_list ap;
+	IpcClient *c, *next;
+
+	if (!(ipcsubscribed & 1 << ev))
+		return;
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if (len < 0)
+		return;
+	if ((size_t)len >= sizeof(buf)) {
+		len = sizeof(buf) - 1;
+		buf[len - 1] = '\n';
+	}
+	for (c = ipcclients; c; c = next) {
+		next = c->next;
+		if (c->events & 1 << ev)
+			ipcappend(c, buf, len);
+	}
+}
+
+int
+ipcexec(char *cmd, const char **err)
+{
+	char name[64], type[3], *p, *end;
+	int i, n;
+	Arg arg = {0};
+
+	if (sscanf(cmd, "%63s%n", name, &n) != 1) {
+		*err = "empty command";
+		return 0;
+	}
+	for (p = cmd + n; *p == ' ' || *p == '\t'; p++);
+	if (*p) {
+		if (sscanf(p, "%2s%n", type, &n) != 1 || (p[n] && p[n] != ' ' && p[n] != '\t')) {
+			*err = "invalid argument type";
+			return 0;
+		}
+		for (p += n; *p == ' ' || *p == '\t'; p++);
+		errno = 0;
+		if (!strcmp(type, "i"))
+			arg.i = strtol(p, &end, 0);
+		else if (!strcmp(type, "ui"))
+			arg.ui = strtoul(p, &end, 0);
+		else if (!strcmp(type, "f"))
+			arg.f = strtof(p, &end);
+		else if (!strcmp(type, "s"))
+			arg.v = p, end = p + strlen(p);
+		else {
+			*err = "invalid argument type";
+			return 0;
+		}
+		for (; *end == ' ' || *end == '\t'; end++);
+		if (end == p || *end || errno) {
+			*err = "invalid argument value";
+			return 0;
+		}
+	}
+	for (i = 0; i < LENGTH(signals) && strcmp(name, signals[i].sig); i++);
+	if (i == LENGTH(signals) || !signals[i].func) {
+		*err = "unknown command";
+		return 0;
+	}
+	signals[i].func(&arg);
+	return 1;
+}
+
+/* returns 0 when the client had to be dropped */
+int
+ipcflush(IpcClient *c)
+{
+	ssize_t n;
+
+	if (c->dead)
+		return 0;
+	while (c->outlen) {
+		if ((n = send(c->fd, c->out, c->outlen, IPCSENDFLAGS)) == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				ipcclose(c);
+				return 0;
+			}
+			break;
+		}
+		c->outlen -= n;
+		memmove(c->out, c->out + n, c->outlen);
+	}
+	if (c->pollout != (c->outlen > 0)) {
+		c->pollout = c->outlen > 0;
+		watchfdwrite(c->fd, WatchIpcClient, c->pollout);
+	}
+	return 1;
+}
+
+/* publishes the focus, tags and layout changes since the last call; run
+ * once the event queue is drained */
+void
+ipcnotify(void)
+{
+	char buf[IPCLINESIZE];
+	int len, all = 0;
+	unsigned int changed;
+	Client *c;
+	Monitor *m;
+	IpcClient *ic, *next;
+	IpcMonState s;
+	Window focus;
+
+	if (!(ipcsubscribed & (1 << IpcEvFocus | 1 << IpcEvTags | 1 << IpcEvLayout)))
+		return;
+	for (ic = ipcclients; ic; ic = ic->next)
+		all |= ic->fresh;
+
+	for (m = mons; m; m = m->next) {
+		if (m->num >= ipcnmonstate) {
+			ipcmonstate = realloc(ipcmonstate, (m->num + 1) * sizeof(IpcMonState));
+			if (!ipcmonstate)
+				die("realloc:");
+			memset(ipcmonstate + ipcnmonstate, 0, (m->num + 1 - ipcnmonstate) * sizeof(IpcMonState));
+			ipcnmonstate = m->num + 1;
+		}
+		memset(&s, 0, sizeof(s));
+		s.tagset = m->tagset[m->seltags];
+		for (c = m->clients; c; c = c->next) {
+			s.occ |= c->tags;
+			if (c->isurgent)
+				s.urg |= c->tags;
+		}
+		s.lt = m->lt[m->sellt];
+		s.mfact = m->mfact;
+		s.nmaster = m->nmaster;
+		memcpy(s.ltsymbol, m->ltsymbol, sizeof(s.ltsymbol));
+
+		changed = 0;
+		if (s.tagset != ipcmonstate[m->num].tagset || s.occ != ipcmonstate[m->num].occ
+		|| s.urg != ipcmonstate[m->num].urg)
+			changed |= 1 << IpcEvTags;
+		if (s.lt != ipcmonstate[m->num].lt || s.mfact != ipcmonstate[m->num].mfact
+		|| s.nmaster != ipcmonstate[m->num].nmaster || strcmp(s.ltsymbol, ipcmonstate[m->num].ltsymbol))
+			changed |= 1 << IpcEvLayout;
+		ipcmonstate[m->num] = s;
+		if (!changed && !all)
+			continue;
+
+		for (ic = ipcclients; ic; ic = next) {
+			next = ic->next;
+			if ((ic->events & 1 << IpcEvTags) && (changed & 1 << IpcEvTags || ic->fresh)) {
+				len = snprintf(buf, sizeof(buf), "tags %d %u %u %u\n", m->num, s.tagset, s.occ, s.urg);
+				if (!ipcappend(ic, buf, len))
+					continue;
+			}
+			if ((ic->events & 1 << IpcEvLayout) && (changed & 1 << IpcEvLayout || ic->fresh)) {
+				len = snprintf(buf, sizeof(buf), "layout %d %d %.2f %d %s\n", m->num,
+					(int)(s.lt - layouts), s.mfact, s.nmaster, s.ltsymbol);
+				ipcappend(ic, buf, len);
+			}
+		}
+	}
+
+	focus = selmon->sel ? selmon->sel->win : None;
+	changed = focus != ipcfocus || selmon->num != ipcfocusmon;
+	ipcfocus = focus;
+	ipcfocusmon = selmon->num;
+	for (ic = ipcclients; ic; ic = next) {
+		next = ic->next;
+		if ((ic->events & 1 << IpcEvFocus) && (changed || ic->fresh)) {
+			len = snprintf(buf, sizeof(buf), "focus %d 0x%lx\n", selmon->num, focus);
+			if (!ipcappend(ic, buf, len))
+				continue;
+		}
+		ic->fresh = 0;
+	}
+}
+
+void
+ipcread(int fd)
+{
+	char *line, *nl;
+	const char *err;
+	ssize_t n;
+	IpcClient *c;
+
+	for (c = ipcclients; c && c->fd != fd; c = c->next);
+	if (!c || (c->outlen && !ipcflush(c)))
+		return;
+	ipcreading = c;
+	while ((n = read(fd, c->in + c->inlen, sizeof(c->in) - c->inlen)) > 0) {
+		c->inlen += n;
+		for (line = c->in; !c->dead && (nl = memchr(line, '\n', c->in + c->inlen - line)); line = nl + 1) {
+			*nl = '\0';
+			if (nl > line && nl[-1] == '\r')
+				nl[-1] = '\0';
+			if (!strncmp(line, "subscribe", 9) && (!line[9] || line[9] == ' ')) {
+				!ipcsubscribe(c, line + 9, &err) ? ipcreply(c, "error %s\n", err) : ipcreply(c, "ok\n");
+			} else if (!strncmp(line, "batch", 5) && (!line[5] || line[5] == ' ')) {
+				!ipcbatch(line + 5, &err) ? ipcreply(c, "error %s\n", err) : ipcreply(c, "ok\n");
+			} else if (!strncmp(line, "state", 5) && (!line[5] || line[5] == ' ')) {
+				if (ipcstate(c, line + 5, &err) < 0)
+					ipcreply(c, "error %s\n", err);
+			} else if (!strncmp(line, "stats", 5) && (!line[5] || line[5] == ' ')) {
+				if (ipcstats(c, line + 5, &err) < 0)
+					ipcreply(c, "error %s\n", err);
+			} else if (!strncmp(line, "trace", 5) && (!line[5] || line[5] == ' ')) {
+				!ipctrace(line + 5, &err) ? ipcreply(c, "error %s\n", err) : ipcreply(c, "ok\n");
+			} else if (!strncmp(line, "record", 6) && (!line[6] || line[6] == ' ')) {
+				!ipcrecord(line + 6, &err) ? ipcreply(c, "error %s\n", err) : ipcreply(c, "ok\n");
+			} else {
+				!ipcexec(line, &err) ? ipcreply(c, "error %s\n", err) : ipcreply(c, "ok\n");
+			}
+		}
+		if (c->dead)
+			break;
+		c->inlen -= line - c->in;
+		memmove(c->in, line, c->inlen);
+		if (c->inlen == sizeof(c->in)) {
+			ipcreply(c, "error line too long\n");
+			ipcclose(c);
+			break;
+		}
+	}
+	ipcreading = NULL;
+	if (c->dead || n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+		ipcclose(c);
+}
+
+int
+ipcrecord(char *args, const char **err)
+{
+	char *cmd, *path;
+
+	if (!(cmd = strtok(args, " \t"))) {
+		*err = "missing record command";
+		return 0;
+	}
+	if (!strcmp(cmd, "start")) {
+		if (!(path = strtok(NULL, ""))) {
+			*err = "missing path";
+			return 0;
+		}
+		if (!recordstart(path)) {
+			*err = "cannot open file";
+			return 0;
+		}
+	} else if (!strcmp(cmd, "stop")) {
+		if (!recordstop()) {
+			*err = "cannot write recording";
+			return 0;
+		}
+	} else {
+		*err = "unknown record command";
+		return 0;
+	}
+	return 1;
+}
+
+/* a client that does not read its replies is dropped instead of blocking
+ * the window manager; returns 0 when that happened */
+int
+ipcreply(IpcClient *c, const char *fmt, ...)
+{
+	char buf[256];
+	int len;
+	va_list ap;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if (len < 0 || (size_t)len >= sizeof(buf)) {
+		ipcclose(c);
+		return 0;
+	}
+	return ipcappend(c, buf, len);
+}
+
+void
+ipcsetup(void)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	mode_t mask;
+
+	if (!ipcsocketpath(ipcsockpath, sizeof(ipcsockpath))) {
+		fputs("dwm: ipc socket path too long\n", stderr);
+		return;
+	}
+	strcpy(addr.sun_path, ipcsockpath);
+	if ((ipcfd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		perror("dwm: ipc socket");
+		return;
+	}
+	fcntl(ipcfd, F_SETFD, FD_CLOEXEC);
+	fcntl(ipcfd, F_SETFL, O_NONBLOCK);
+	/* another dwm on this display would have failed in checkotherwm() */
+	unlink(ipcsockpath);
+	mask = umask(0077);
+	if (bind(ipcfd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(ipcfd, 8) == -1) {
+		umask(mask);
+		perror("dwm: ipc bind");
+		close(ipcfd);
+		ipcfd = -1;
+		return;
+	}
+	umask(mask);
+	setenv("DWM_SOCKET", ipcsockpath, 1);
+	watchfd(ipcfd, WatchIpc);
+}
+
+int
+ipcsend(int argc, char *argv[])
+{
+	char buf[IPCLINESIZE], path[sizeof(ipcsockpath)], *nl;
+	int fd, i;
+	size_t len = 0, size;
+	ssize_t n;
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+	for (i = 0; i < argc; i++) {
+		n = snprintf(buf + len, sizeof(buf) - len, "%s%s", argv[i], i + 1 < argc ? " " : "\n");
+		if (n < 0 || (size_t)n >= sizeof(buf) - len)
+			die("dwm: command too long");
+		len += n;
+	}
+	if (!ipcsocketpath(path, sizeof(path)))
+		die("dwm: ipc socket path too long");
+	strcpy(addr.sun_path, path);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1
+	|| connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+		die("dwm: cannot connect to '%s':", path);
+	if (write(fd, buf, len) != (ssize_t)len)
+		die("dwm: write:");
+	for (len = 0, nl = NULL; len < sizeof(buf) && !(nl = memchr(buf, '\n', len)); len += n)
+		if ((n = read(fd, buf + len, sizeof(buf) - len)) <= 0)
+			break;
+	if (!nl)
+		die("dwm: no reply");
+	*nl = '\0';
+	if (strncmp(buf, "ok", 2) || (buf[2] && buf[2] != ' ')) {
+		fprintf(stderr, "%s\n", buf);
+		return EXIT_FAILURE;
+	}
+	/* "ok <length>" is followed by a payload */
+	size = strtoul(buf + 2, NULL, 10);
+	len -= nl + 1 - buf;
+	fwrite(nl + 1, 1, MIN(len, size), stdout);
+	for (size -= MIN(len, size); size && (n = read(fd, buf, MIN(size, sizeof(buf)))) > 0; size -= n)
+		fwrite(buf, 1, n, stdout);
+	close(fd);
+	return size ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* $DWM_SOCKET, or dwm-$DISPLAY.sock in $XDG_RUNTIME_DIR (/tmp if unset) */
+int
+ipcsocketpath(char *buf, size_t size)
+{
+	const char *env, *dir;
+	int n;
+
+	if ((env = getenv("DWM_SOCKET")) && *env)
+		n = snprintf(buf, size, "%s", env);
+	else {
+		dir = (dir = getenv("XDG_RUNTIME_DIR")) && *dir ? dir : "/tmp";
+		env = (env = getenv("DISPLAY")) ? env : "";
+		n = snprintf(buf, size, "%s/dwm-%s.sock", dir, env);
+	}
+	return n >= 0 && (size_t)n < size;
+}
+
+/* returns -1 with err set on bad arguments, 0 when the client was dropped */
+int
+ipcstate(IpcClient *c, char *args, const char **err)
+{
+	static IpcBuf b;
+	char *fmt, hdr[32];
+	int len;
+
+	fmt = strtok(args, " \t");
+	b.len = 0;
+	if (!fmt || !strcmp(fmt, "json"))
+		ipcstatejson(&b);
+	else if (!strcmp(fmt, "binary"))
+		ipcstatebinary(&b);
+	else {
+		*err = "unknown format";
+		return -1;
+	}
+	len = snprintf(hdr, sizeof(hdr), "ok %zu\n", b.len);
+	return ipcappend(c, hdr, len) && ipcappend(c, b.data, b.len);
+}
+
+void
+ipcstatebinary(IpcBuf *b)
+{
+	size_t n, pos;
+	unsigned int i;
+	float f;
+	Client *c;
+	Monitor *m;
+	Pertag *pt;
+
+	for (n = 0, m = mons; m; m = m->next, n++);
+	ipcbufu32(b, IPCSTATEMAGIC);
+	ipcbufu32(b, 1);
+	ipcbufu32(b, LENGTH(tags));
+	ipcbufu32(b, selmon->num);
+	ipcbufu32(b, n);
+	for (m = mons; m; m = m->next) {
+		pt = m->pertag;
+		ipcbufu32(b, m->num);
+		ipcbufu32(b, m->mx); ipcbufu32(b, m->my); ipcbufu32(b, m->mw); ipcbufu32(b, m->mh);
+		ipcbufu32(b, m->wx); ipcbufu32(b, m->wy); ipcbufu32(b, m->ww); ipcbufu32(b, m->wh);
+		ipcbufu32(b, m->showbar);
+		ipcbufu32(b, m->topbar);
+		ipcbufu32(b, m->tagset[0]);
+		ipcbufu32(b, m->tagset[1]);
+		ipcbufu32(b, m->seltags);
+		ipcbufu32(b, m->lt[0] - layouts);
+		ipcbufu32(b, m->lt[1] - layouts);
+		ipcbufu32(b, m->sellt);
+		ipcbufu32(b, m->att[0] - attachs);
+		ipcbufu32(b, m->att[1] - attachs);
+		ipcbufu32(b, m->selatt);
+		f = m->mfact;
+		ipcbufput(b, &f, sizeof(f));
+		ipcbufu32(b, m->nmaster);
+		ipcbufu32(b, m->gappih); ipcbufu32(b, m->gappiv); ipcbufu32(b, m->gappoh); ipcbufu32(b, m->gappov);
+		ipcbufu32(b, m->sel ? m->sel->win : None);
+		ipcbufu32(b, pt->curtag);
+		ipcbufu32(b, pt->prevtag);
+		for (i = 0; i <= LENGTH(tags); i++) {
+			ipcbufu32(b, pt->nmasters[i]);
+			f = pt->mfacts[i];
+			ipcbufput(b, &f, sizeof(f));
+			ipcbufu32(b, pt->sellts[i]);
+			ipcbufu32(b, pt->ltidxs[i][0] - layouts);
+			ipcbufu32(b, pt->ltidxs[i][1] - layouts);
+			ipcbufu32(b, pt->showbars[i]);
+			ipcbufu32(b, pt->selatts[i]);
+			ipcbufu32(b, pt->attidxs[i][0] - attachs);
+			ipcbufu32(b, pt->attidxs[i][1] - attachs);
+			ipcbufu32(b, pt->enablegaps[i]);
+			ipcbufu32(b, pt->gaps[i]);
+			ipcbufu32(b, ipcwin(m, pt->prevzooms[i]));
+		}
+		pos = b->len;
+		ipcbufu32(b, 0);
+		for (n = 0, c = m->clients; c; c = c->next, n++) {
+			ipcbufu32(b, c->win);
+			ipcbufu32(b, c->tags);
+			ipcbufu32(b, (c->isfloating ? IPCFFloating : 0) | (c->isfullscreen ? IPCFFullscreen : 0)
+				| (c->fakefullscreen ? IPCFFakeFullscreen : 0) | (c->issticky ? IPCFSticky : 0)
+				| (c->isurgent ? IPCFUrgent : 0) | (c->neverfocus ? IPCFNeverFocus : 0)
+				| (c->isfixed ? IPCFFixed : 0) | (c->isterminal ? IPCFTerminal : 0));
+			ipcbufu32(b, c->noswallow);
+			ipcbufu32(b, c->swallowing ? c->swallowing->win : None);
+			ipcbufu32(b, c->x); ipcbufu32(b, c->y); ipcbufu32(b, c->w); ipcbufu32(b, c->h);
+			ipcbufu32(b, c->bw);
+			ipcbufu32(b, c->pid);
+			f = c->cfact;
+			ipcbufput(b, &f, sizeof(f));
+			ipcbufu32(b, strlen(c->name));
+			ipcbufput(b, c->name, strlen(c->name));
+		}
+		memcpy(b->data + pos, &(uint32_t){n}, sizeof(uint32_t));
+		for (n = 0, c = m->stack; c; c = c->snext, n++);
+		ipcbufu32(b, n);
+		for (c = m->stack; c; c = c->snext)
+			ipcbufu32(b, c->win);
+	}
+}
+
+void
+ipcstatejson(IpcBuf *b)
+{
+	unsigned int i;
+	Client *c;
+	Monitor *m;
+	Pertag *pt;
+
+	ipcbufprintf(b, "{\"selmon\":%d,\"tags\":%d,\"monitors\":[", selmon->num, (int)LENGTH(tags));
+	for (m = mons; m; m = m->next) {
+		pt = m->pertag;
+		ipcbufprintf(b, "%s{\"num\":%d,\"geometry\":[%d,%d,%d,%d],\"area\":[%d,%d,%d,%d],"
+			"\"showbar\":%d,\"topbar\":%d,\"tagset\":[%u,%u],\"seltags\":%u,"
+			"\"layouts\":[%d,%d],\"sellt\":%u,\"ltsymbol\":",
+			m == mons ? "" : ",", m->num, m->mx, m->my, m->mw, m->mh, m->wx, m->wy, m->ww, m->wh,
+			m->showbar, m->topbar, m->tagset[0], m->tagset[1], m->seltags,
+			(int)(m->lt[0] - layouts), (int)(m->lt[1] - layouts), m->sellt);
+		ipcbufjsonstr(b, m->ltsymbol);
+		ipcbufprintf(b, ",\"attachs\":[%d,%d],\"selatt\":%u,\"mfact\":%g,\"nmaster\":%d,"
+			"\"gaps\":[%d,%d,%d,%d],\"sel\":%lu,\"pertag\":{\"curtag\":%u,\"prevtag\":%u,\"tags\":[",
+			(int)(m->att[0] - attachs), (int)(m->att[1] - attachs), m->selatt, m->mfact, m->nmaster,
+			m->gappih, m->gappiv, m->gappoh, m->gappov, m->sel ? m->sel->win : None,
+			pt->curtag, pt->prevtag);
+		for (i = 0; i <= LENGTH(tags); i++)
+			ipcbufprintf(b, "%s{\"nmaster\":%d,\"mfact\":%g,\"sellt\":%u,\"layouts\":[%d,%d],"
+				"\"showbar\":%d,\"selatt\":%u,\"attachs\":[%d,%d],\"enablegaps\":%d,"
+				"\"gaps\":%u,\"prevzoom\":%lu}",
+				i ? "," : "", pt->nmasters[i], pt->mfacts[i], pt->sellts[i],
+				(int)(pt->ltidxs[i][0] - layouts), (int)(pt->ltidxs[i][1] - layouts),
+				pt->showbars[i], pt->selatts[i],
+				(int)(pt->attidxs[i][0] - attachs), (int)(pt->attidxs[i][1] - attachs),
+				pt->enablegaps[i], pt->gaps[i], ipcwin(m, pt->prevzooms[i]));
+		ipcbufprintf(b, "]},\"clients\":[");
+		for (c = m->clients; c; c = c->next) {
+			ipcbufprintf(b, "%s{\"win\":%lu,\"name\":", c == m->clients ? "" : ",", c->win);
+			ipcbufjsonstr(b, c->name);
+			ipcbufprintf(b, ",\"tags\":%u,\"geometry\":[%d,%d,%d,%d],\"bw\":%d,\"cfact\":%g,"
+				"\"pid\":%d,\"floating\":%d,\"fullscreen\":%d,\"fakefullscreen\":%d,"
+				"\"sticky\":%d,\"urgent\":%d,\"neverfocus\":%d,\"fixed\":%d,"
+				"\"terminal\":%d,\"noswallow\":%d,\"swallowing\":%lu}",
+				c->tags, c->x, c->y, c->w, c->h, c->bw, c->cfact, (int)c->pid,
+				c->isfloating, c->isfullscreen, c->fakefullscreen, c->issticky, c->isurgent,
+				c->neverfocus, c->isfixed, c->isterminal, c->noswallow,
+				c->swallowing ? c->swallowing->win : None);
+		}
+		ipcbufprintf(b, "],\"stack\":[");
+		for (c = m->stack; c; c = c->snext)
+			ipcbufprintf(b, "%s%lu", c == m->stack ? "" : ",", c->win);
+		ipcbufprintf(b, "]}");
+	}
+	ipcbufprintf(b, "]}\n");
+}
+
+/* returns -1 with err set on bad arguments, 0 when the client was dropped */
+int
+ipcstats(IpcClient *c, char *args, const char **err)
+{
+	static IpcBuf b;
+	char *cmd, hdr[32];
+	int len;
+
+	if ((cmd = strtok(args, " \t"))) {
+		if (!strcmp(cmd, "on"))
+			stats = 1;
+		else if (!strcmp(cmd, "off"))
+			stats = 0;
+		else if (!strcmp(cmd, "reset"))
+			statsreset();
+		else {
+			*err = "unknown stats command";
+			return -1;
+		}
+		return ipcreply(c, "ok\n");
+	}
+	b.len = 0;
+	statsdump(&b);
+	len = snprintf(hdr, sizeof(hdr), "ok %zu\n", b.len);
+	return ipcappend(c, hdr, len) && ipcappend(c, b.data, b.len);
+}
+
+int
+ipctrace(char *args, const char **err)
+{
+	char *cmd;
+
+	if (!(cmd = strtok(args, " \t"))) {
+		*err = "missing trace command";
+		return 0;
+	}
+	if (!strcmp(cmd, "on"))
+		traceenable(1);
+	else if (!strcmp(cmd, "off"))
+		traceenable(0);
+	else if (!strcmp(cmd, "write")) {
+		if (!tracewrite(strtok(NULL, ""))) {
+			*err = "cannot write trace";
+			return 0;
+		}
+	} else {
+		*err = "unknown trace command";
+		return 0;
+	}
+	return 1;
+}
+
+int
+ipcsubscribe(IpcClient *c, char *args, const char **err)
+{
+	char *tok;
+	int i;
+	unsigned int events = 0;
+
+	for (tok = strtok(args, " \t"); tok; tok = strtok(NULL, " \t")) {
+		if (!strcmp(tok, "all")) {
+			events = ~0;
+			continue;
+		}
+		for (i = 0; i < IpcEvLast && strcmp(tok, ipcevnames[i]); i++);
+		if (i == IpcEvLast) {
+			*err = "unknown event";
+			return 0;
+		}
+		events |= 1 << i;
+	}
+	c->events = events ? events & ((1 << IpcEvLast) - 1) : (1 << IpcEvLast) - 1;
+	c->fresh = 1;
+	ipcsubscribed |= c->events;
+	return 1;
+}
+
+/* pertag client pointers are not cleared on unmanage, so only trust them
+ * while they still point into the monitor's client list */
+Window
+ipcwin(Monitor *m, Client *c)
+{
+	Client *i;
+
+	for (i = m->clients; i && i != c; i = i->next);
+	return i ? i->win : None;
+}
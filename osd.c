@@ -0,0 +1,123 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * On-screen display. osd() shows a line of text in an override-redirect
+ * window centred on the selected monitor and TimerOsd hides it osdtimeout ms
+ * later. Changes to nmaster, mfact, cfact, the gaps and the layout report
+ * their new value here, so holding a key down redraws one window instead of
+ * starting a notification command per repeat. The text is drawn with drw in
+ * osdfonts, or the bar fonts if those cannot be loaded.
+ *
+ * Mouse drags and IPC batches change these values many times in a row.
+ * While osdhold or batch is set, osd() only keeps the text, and osdflush()
+ * shows the last one when the drag or batch ends.
+ */
+
+static void osdcleanup(void);
+static void osddraw(void);
+static void osdflush(void);
+static void osdsetup(void);
+static void osdshow(void);
+
+static Window osdwin;
+static Fnt *osdfnt;
+static char osdtext[256];
+static unsigned int osdw, osdh;
+static int osdhold;    /* set while a drag runs */
+static int osdpending; /* osdtext has not been shown yet */
+
+void
+osd(const char *fmt, ...)
+{
+	va_list ap;
+
+	if (!osdtimeout || !selmon)
+		return;
+	va_start(ap, fmt);
+	vsnprintf(osdtext, sizeof(osdtext), fmt, ap);
+	va_end(ap);
+	osdpending = 1;
+	if (!osdhold && !batch)
+		osdshow();
+}
+
+void
+osdcleanup(void)
+{
+	if (osdwin)
+		XDestroyWindow(dpy, osdwin);
+	osdwin = None;
+	drw_fontset_free(osdfnt);
+	osdfnt = NULL;
+}
+
+void
+osddraw(void)
+{
+	Fnt *bar = drw->fonts, *fnt = osdfnt ? osdfnt : bar;
+
+	/* configurenotify() shrinks the pixmap to the bar height */
+	if (osdw > drw->w || osdh > drw->h)
+		drw_resize(drw, MAX(osdw, drw->w), MAX(osdh, drw->h));
+	drw_setfontset(drw, fnt);
+	drw_setscheme(drw, scheme[SchemeSel]);
+	xfttext(drw, 0, 0, osdw, osdh, fnt->h, osdtext, 0);
+	drw_setfontset(drw, bar);
+	drw_map(drw, osdwin, 0, 0, osdw, osdh);
+}
+
+/* shows the text held back by a drag or batch once both have ended */
+void
+osdflush(void)
+{
+	if (osdpending && !osdhold && !batch && selmon)
+		osdshow();
+}
+
+/* TimerOsd */
+void
+osdhide(void)
+{
+	if (osdwin)
+		XUnmapWindow(dpy, osdwin);
+}
+
+/* the bar fonts stay current; osdfonts is swapped in around each draw */
+void
+osdsetup(void)
+{
+	Fnt *bar = drw->fonts;
+
+	if (!osdtimeout)
+		return;
+	osdfnt = drw_fontset_create(drw, osdfonts, LENGTH(osdfonts));
+	drw_setfontset(drw, bar);
+}
+
+void
+osdshow(void)
+{
+	XSetWindowAttributes wa = {
+		.override_redirect = True,
+		.background_pixmap = ParentRelative,
+		.event_mask = ExposureMask
+	};
+	XClassHint ch = {"dwm", "dwm"};
+	Fnt *bar = drw->fonts, *fnt = osdfnt ? osdfnt : bar;
+
+	osdpending = 0;
+	if (!osdwin) {
+		osdwin = XCreateWindow(dpy, root, 0, 0, 1, 1, 0, DefaultDepth(dpy, screen),
+			CopyFromParent, DefaultVisual(dpy, screen),
+			CWOverrideRedirect|CWBackPixmap|CWEventMask, &wa);
+		XSetClassHint(dpy, osdwin, &ch);
+	}
+	drw_setfontset(drw, fnt);
+	osdw = MIN(xftwidth(drw, osdtext) + 2 * fnt->h, selmon->ww);
+	drw_setfontset(drw, bar);
+	osdh = 2 * fnt->h;
+	XMoveResizeWindow(dpy, osdwin, selmon->wx + (selmon->ww - osdw) / 2,
+		selmon->wy + (selmon->wh - osdh) / 2, osdw, osdh);
+	XMapRaised(dpy, osdwin);
+	osddraw();
+	settimer(TimerOsd, osdtimeout);
+}
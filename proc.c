@@ -0,0 +1,317 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Process tracking over the Linux netlink process connector. With
+ * procconnector set in config.h dwm subscribes to the kernel's process
+ * events and keeps a table of every live process and its parent. The table
+ * is seeded from /proc at startup and then kept current by fork and exit
+ * events; exec keeps both the pid and the parent, so it changes nothing.
+ * Swallowing answers parent lookups from the table (see getparentprocess),
+ * isprocessrunning() becomes a lookup, and a tray icon whose process exits
+ * is dropped right away instead of when its one second grace period ends.
+ *
+ * A lookup that misses first drains the socket, as the fork of a process
+ * that just mapped a window may still be queued. A parent that has already
+ * exited means the process was reparented, so it is read from /proc again.
+ * If the kernel drops events, the table is rebuilt from /proc.
+ *
+ * Listening needs CAP_NET_ADMIN on most kernels. If the socket cannot be
+ * opened, bound or subscribed, and on other systems, dwm keeps reading
+ * /proc and calling kill(pid, 0) as before.
+ */
+
+#define PROCACKTIMEOUT 100 /* ms to wait for the kernel to confirm the subscription */
+
+typedef struct {
+	pid_t pid, ppid; /* pid 0 marks a free slot */
+} ProcNode;
+
+static void proccleanup(void);
+static pid_t procparent(pid_t pid);
+static int procrunning(pid_t pid);
+static void procsetup(void);
+
+static int procfd = -1;
+
+#if defined(__linux__)
+static void procevent(struct proc_event *ev);
+static void procexited(pid_t pid);
+static ProcNode *procfind(pid_t pid);
+static void procgrow(void);
+static void procinsert(pid_t pid, pid_t ppid);
+static void procremove(pid_t pid);
+static void procscan(void);
+
+static ProcNode *proctab;
+static unsigned int proctabsize, nprocs; /* open addressing, linear probing */
+static int procack;
+
+void
+proccleanup(void)
+{
+	if (procfd >= 0) {
+		unwatchfd(procfd);
+		close(procfd);
+	}
+	procfd = -1;
+	free(proctab);
+	proctab = NULL;
+	proctabsize = nprocs = 0;
+}
+
+void
+procevent(struct proc_event *ev)
+{
+	switch (ev->what) {
+	case PROC_EVENT_NONE:
+		procack = ev->event_data.ack.err;
+		break;
+	case PROC_EVENT_FORK:
+		/* new threads are forks too */
+		if (ev->event_data.fork.child_pid == ev->event_data.fork.child_tgid)
+			procinsert(ev->event_data.fork.child_tgid, ev->event_data.fork.parent_tgid);
+		break;
+	case PROC_EVENT_EXIT:
+		if (ev->event_data.exit.process_pid == ev->event_data.exit.process_tgid) {
+			procremove(ev->event_data.exit.process_tgid);
+			procexited(ev->event_data.exit.process_tgid);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/* lookups can run in the middle of manage(), so the tray is only told to
+ * refresh from the event loop */
+void
+procexited(pid_t pid)
+{
+	Client *c;
+
+	if (!showsystray || !systray)
+		return;
+	for (c = systray->icons; c; c = c->next)
+		if (c->iconremoved && c->pid == pid) {
+			settimer(TimerSystray, 0);
+			return;
+		}
+}
+
+ProcNode *
+procfind(pid_t pid)
+{
+	unsigned int i, mask = proctabsize - 1;
+
+	if (!proctabsize || pid <= 0)
+		return NULL;
+	for (i = pid & mask; proctab[i].pid; i = (i + 1) & mask)
+		if (proctab[i].pid == pid)
+			return &proctab[i];
+	return NULL;
+}
+
+void
+procgrow(void)
+{
+	ProcNode *old = proctab;
+	unsigned int i, n = proctabsize;
+
+	proctabsize = n ? 2 * n : 1024;
+	proctab = ecalloc(proctabsize, sizeof(ProcNode));
+	nprocs = 0;
+	for (i = 0; i < n; i++)
+		if (old[i].pid)
+			procinsert(old[i].pid, old[i].ppid);
+	free(old);
+}
+
+void
+procinsert(pid_t pid, pid_t ppid)
+{
+	ProcNode *p;
+	unsigned int i, mask;
+
+	if (pid <= 0)
+		return;
+	if ((p = procfind(pid))) {
+		p->ppid = ppid;
+		return;
+	}
+	if (2 * (nprocs + 1) > proctabsize)
+		procgrow();
+	mask = proctabsize - 1;
+	for (i = pid & mask; proctab[i].pid; i = (i + 1) & mask);
+	proctab[i].pid = pid;
+	proctab[i].ppid = ppid;
+	nprocs++;
+}
+
+pid_t
+procparent(pid_t pid)
+{
+	ProcNode *p;
+	pid_t ppid;
+
+	if (!(p = procfind(pid))) {
+		procread(procfd);
+		p = procfind(pid);
+	}
+	if (p && (p->ppid <= 1 || procfind(p->ppid)))
+		return p->ppid;
+	if ((ppid = readparentprocess(pid)))
+		procinsert(pid, ppid);
+	return ppid;
+}
+
+void
+procread(int fd)
+{
+	union {
+		struct nlmsghdr nl;
+		char buf[8192];
+	} msg;
+	struct sockaddr_nl addr;
+	socklen_t addrlen;
+	struct nlmsghdr *nl;
+	struct cn_msg *cn;
+	ssize_t n;
+
+	for (;;) {
+		addrlen = sizeof(addr);
+		if ((n = recvfrom(fd, &msg, sizeof(msg), 0, (struct sockaddr *)&addr, &addrlen)) < 0) {
+			if (errno == ENOBUFS) {
+				procscan();
+				continue;
+			}
+			break;
+		}
+		if (addr.nl_pid != 0) /* not from the kernel */
+			continue;
+		for (nl = &msg.nl; NLMSG_OK(nl, n); nl = NLMSG_NEXT(nl, n)) {
+			cn = NLMSG_DATA(nl);
+			if (cn->id.idx == CN_IDX_PROC && cn->id.val == CN_VAL_PROC)
+				procevent((struct proc_event *)cn->data);
+		}
+	}
+}
+
+/* backward-shift deletion keeps every probe sequence unbroken */
+void
+procremove(pid_t pid)
+{
+	ProcNode *p;
+	unsigned int i, j, k, mask = proctabsize - 1;
+
+	if (!(p = procfind(pid)))
+		return;
+	for (i = j = p - proctab;;) {
+		j = (j + 1) & mask;
+		if (!proctab[j].pid)
+			break;
+		k = proctab[j].pid & mask;
+		if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+			proctab[i] = proctab[j];
+			i = j;
+		}
+	}
+	proctab[i].pid = 0;
+	nprocs--;
+}
+
+/* the exit may still be queued */
+int
+procrunning(pid_t pid)
+{
+	procread(procfd);
+	return procfind(pid) != NULL;
+}
+
+void
+procscan(void)
+{
+	DIR *d;
+	struct dirent *de;
+	char *end;
+	long pid;
+
+	if (proctab)
+		memset(proctab, 0, proctabsize * sizeof(ProcNode));
+	nprocs = 0;
+	if (!(d = opendir("/proc")))
+		return;
+	while ((de = readdir(d)))
+		if ((pid = strtol(de->d_name, &end, 10)) > 0 && !*end)
+			procinsert(pid, readparentprocess(pid));
+	closedir(d);
+}
+
+void
+procsetup(void)
+{
+	struct sockaddr_nl addr = { .nl_family = AF_NETLINK, .nl_groups = CN_IDX_PROC };
+	enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+	union {
+		struct nlmsghdr nl;
+		char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))];
+	} msg;
+	struct pollfd pfd;
+	struct cn_msg *cn;
+
+	if (!procconnector)
+		return;
+	if ((procfd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR)) < 0)
+		return;
+	memset(&msg, 0, sizeof(msg));
+	msg.nl.nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+	msg.nl.nlmsg_type = NLMSG_DONE;
+	cn = NLMSG_DATA(&msg.nl);
+	cn->id.idx = CN_IDX_PROC;
+	cn->id.val = CN_VAL_PROC;
+	cn->len = sizeof(op);
+	memcpy(cn->data, &op, sizeof(op));
+
+	procack = -1;
+	if (bind(procfd, (struct sockaddr *)&addr, sizeof(addr)) == 0
+	&& send(procfd, &msg, msg.nl.nlmsg_len, 0) >= 0) {
+		/* the kernel answers with an ack carrying the error, if any */
+		pfd.fd = procfd;
+		pfd.events = POLLIN;
+		while (procack < 0 && poll(&pfd, 1, PROCACKTIMEOUT) > 0)
+			procread(procfd);
+	}
+	if (procack != 0) {
+		close(procfd);
+		procfd = -1;
+		return;
+	}
+	procscan();
+	watchfd(procfd, WatchProc);
+}
+#else
+void
+proccleanup(void)
+{
+}
+
+pid_t
+procparent(pid_t pid)
+{
+	return readparentprocess(pid);
+}
+
+void
+procread(int fd)
+{
+}
+
+int
+procrunning(pid_t pid)
+{
+	return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+void
+procsetup(void)
+{
+}
+#endif /* __linux__ */
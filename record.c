@@ -0,0 +1,611 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Event recording and replay. "dwm -r file", or "record start <path>" over
+ * the control socket, writes every event the event loop hands to a handler
+ * to a file, until "record stop" or exit. "dwm -p file" starts dwm on an
+ * empty display (Xvfb, say), feeds the recorded events through the same
+ * handlers as fast as it can and exits. The statistics (see stats.c) and
+ * the trace (see trace.c) are written at the end if either is enabled, so
+ * a recording of a real session can be replayed before and after a change.
+ *
+ * The recorded windows do not exist during replay. Each one is replaced by
+ * an unmapped stub window, created the first time its id comes up, and atoms
+ * are mapped by name. A MapRequest is preceded by everything a handler asks
+ * of the window: its properties, geometry and the pid winpid() found, and a
+ * PropertyNotify by the new value, which the replay sets on the stub first.
+ * Events the replay causes itself are dropped. The drag loops in movemouse,
+ * resizemouse and friends read the queue themselves; their events are
+ * recorded in line and handed back to them. Keycodes replay as they were
+ * recorded, and windows that existed before recording began get empty stubs.
+ *
+ * The file is native-endian and only meant to be read by the same build:
+ *
+ *     "DWMR", u32 version 1, u32 root, u32 nmons, u32 barwin[nmons],
+ *     u32 systray window or 0, then records starting with a u8 kind:
+ *
+ *     'a' u32 atom, u16 length, name            first use of an atom
+ *     'p' u32 window, u32 atom, u32 type, u8 format, u32 nitems,
+ *         nitems values of format bits          property value
+ *     'w' u32 window, u32 pid, i32 x, i32 y, u32 w, u32 h, u32 bw
+ *     'e' u64 ns since start, u8 type, u16 size, the XEvent member
+ *     'm' like 'e', taken by a drag loop
+ *     'r'                                       bars and subscribers updated
+ */
+
+#define RECORDVERSION 1
+
+typedef struct {
+	unsigned long from, to;
+	pid_t pid;
+} ReplayEntry;
+
+typedef struct {
+	ReplayEntry *v;
+	unsigned int n, size;
+} ReplayMap;
+
+static void recordatom(Atom a);
+static void recordevent(char kind, XEvent *ev);
+static int recordisatom(Atom a);
+static int recordmaskevent(Display *d, long mask, XEvent *ev);
+static void recordprop(Window w, Atom prop);
+static void recordput(const void *data, size_t len);
+static void recordrepaint(void);
+static int recordstart(const char *path);
+static int recordstop(void);
+static void recordu32(uint32_t v);
+static void recordwindow(Window w);
+static int replay(const char *path);
+static Atom replayatom(Atom a);
+static void replaydestroy(Window w);
+static ReplayEntry *replayfind(ReplayMap *map, unsigned long from);
+static int replayget(void *data, size_t len);
+static pid_t replaypid(Window w);
+static int replayread(XEvent *ev);
+static void replaytranslate(XEvent *ev);
+static Window replaywin(Window w);
+
+static const unsigned short recordsizes[LASTEvent] = {
+	[KeyPress] = sizeof(XKeyEvent),
+	[KeyRelease] = sizeof(XKeyEvent),
+	[ButtonPress] = sizeof(XButtonEvent),
+	[ButtonRelease] = sizeof(XButtonEvent),
+	[MotionNotify] = sizeof(XMotionEvent),
+	[EnterNotify] = sizeof(XCrossingEvent),
+	[LeaveNotify] = sizeof(XCrossingEvent),
+	[FocusIn] = sizeof(XFocusChangeEvent),
+	[FocusOut] = sizeof(XFocusChangeEvent),
+	[Expose] = sizeof(XExposeEvent),
+	[DestroyNotify] = sizeof(XDestroyWindowEvent),
+	[UnmapNotify] = sizeof(XUnmapEvent),
+	[MapNotify] = sizeof(XMapEvent),
+	[MapRequest] = sizeof(XMapRequestEvent),
+	[ConfigureNotify] = sizeof(XConfigureEvent),
+	[ConfigureRequest] = sizeof(XConfigureRequestEvent),
+	[ResizeRequest] = sizeof(XResizeRequestEvent),
+	[PropertyNotify] = sizeof(XPropertyEvent),
+	[ClientMessage] = sizeof(XClientMessageEvent),
+	[MappingNotify] = sizeof(XMappingEvent),
+};
+
+static FILE *recordfile, *replayfile;
+static long long recordt0;
+static Atom *recordatoms;
+static unsigned int nrecordatoms, recordatomssize;
+static int replaying, replaypending;
+static XEvent replaypendingev;
+static ReplayMap replayatoms, replaywins;
+static Window replayroot, replaysystray, *replaybars;
+static unsigned int nreplaybars;
+
+/* writes the name of an atom the first time it is used; the predefined
+ * atoms are the same on every server */
+void
+recordatom(Atom a)
+{
+	char *name;
+	unsigned int i;
+	uint16_t len;
+
+	if (a <= XA_LAST_PREDEFINED)
+		return;
+	for (i = 0; i < nrecordatoms; i++)
+		if (recordatoms[i] == a)
+			return;
+	if (!(name = XGetAtomName(dpy, a)))
+		return;
+	if (nrecordatoms == recordatomssize) {
+		recordatomssize = recordatomssize ? 2 * recordatomssize : 64;
+		if (!(recordatoms = realloc(recordatoms, recordatomssize * sizeof(Atom))))
+			die("realloc:");
+	}
+	recordatoms[nrecordatoms++] = a;
+	len = MIN(strlen(name), 0xffff);
+	putc('a', recordfile);
+	recordu32(a);
+	recordput(&len, sizeof(len));
+	recordput(name, len);
+	XFree(name);
+}
+
+void
+recordevent(char kind, XEvent *ev)
+{
+	uint64_t t = statsnow() - recordt0;
+	uint16_t size = recordsizes[ev->type] ? recordsizes[ev->type] : sizeof(XEvent);
+	int i;
+
+	switch (ev->type) {
+	case ClientMessage:
+		recordatom(ev->xclient.message_type);
+		if (ev->xclient.format != 32)
+			break;
+		for (i = 0; i < 5; i++)
+			if (recordisatom(ev->xclient.data.l[i]))
+				recordatom(ev->xclient.data.l[i]);
+		if (ev->xclient.message_type == netatom[NetSystemTrayOP])
+			recordwindow(ev->xclient.data.l[2]);
+		break;
+	case MapRequest:
+		recordwindow(ev->xmaprequest.window);
+		break;
+	case PropertyNotify:
+		recordatom(ev->xproperty.atom);
+		if (ev->xproperty.state == PropertyNewValue)
+			recordprop(ev->xproperty.window, ev->xproperty.atom);
+		break;
+	}
+	putc(kind, recordfile);
+	recordput(&t, sizeof(t));
+	putc(ev->type, recordfile);
+	recordput(&size, sizeof(size));
+	recordput(ev, size);
+}
+
+/* client messages carry atoms in untyped data; only those dwm knows are
+ * mapped on replay */
+int
+recordisatom(Atom a)
+{
+	int i;
+
+	for (i = 0; i < NetLast; i++)
+		if (netatom[i] == a)
+			return 1;
+	for (i = 0; i < WMLast; i++)
+		if (wmatom[i] == a)
+			return 1;
+	for (i = 0; i < XLast; i++)
+		if (xatom[i] == a)
+			return 1;
+	return 0;
+}
+
+int
+recordmaskevent(Display *d, long mask, XEvent *ev)
+{
+	int kind;
+
+	if (replaying) {
+		if ((kind = replayread(ev)) == 'm')
+			return 0;
+		/* the replay has diverged from the recording: end the drag and
+		 * leave the record for the event loop */
+		replaypending = kind;
+		replaypendingev = *ev;
+		memset(ev, 0, sizeof(*ev));
+		ev->type = ButtonRelease;
+		ev->xbutton.display = d;
+		ev->xbutton.window = ev->xbutton.root = root;
+		return 0;
+	}
+	XMaskEvent(d, mask, ev);
+	if (recordfile)
+		recordevent('m', ev);
+	return 0;
+}
+
+void
+recordprop(Window w, Atom prop)
+{
+	Atom type;
+	int format;
+	unsigned long i, n, extra;
+	unsigned char *p = NULL;
+	uint16_t v;
+
+	if (XGetWindowProperty(dpy, w, prop, 0L, LONG_MAX, False, AnyPropertyType,
+		&type, &format, &n, &extra, &p) != Success || !p)
+		return;
+	if (type != None) {
+		recordatom(prop);
+		recordatom(type);
+		if (type == XA_ATOM && format == 32)
+			for (i = 0; i < n; i++)
+				recordatom(((Atom *)p)[i]);
+		putc('p', recordfile);
+		recordu32(w);
+		recordu32(prop);
+		recordu32(type);
+		putc(format, recordfile);
+		recordu32(n);
+		if (format == 8)
+			recordput(p, n);
+		else for (i = 0; i < n; i++) {
+			/* Xlib hands out 16 and 32-bit items as short and long */
+			if (format == 16) {
+				v = ((short *)p)[i];
+				recordput(&v, sizeof(v));
+			} else
+				recordu32(((long *)p)[i]);
+		}
+	}
+	XFree(p);
+}
+
+void
+recordput(const void *data, size_t len)
+{
+	fwrite(data, 1, len, recordfile);
+}
+
+void
+recordrepaint(void)
+{
+	putc('r', recordfile);
+}
+
+int
+recordstart(const char *path)
+{
+	uint32_t n = 0;
+	Monitor *m;
+	FILE *f;
+
+	if (!(f = fopen(path, "w")))
+		return 0;
+	recordstop();
+	recordfile = f;
+	recordt0 = statsnow();
+	nrecordatoms = 0;
+	for (m = mons; m; m = m->next)
+		n++;
+	recordput("DWMR", 4);
+	recordu32(RECORDVERSION);
+	recordu32(root);
+	recordu32(n);
+	for (m = mons; m; m = m->next)
+		recordu32(m->barwin);
+	recordu32(showsystray && systray ? systray->win : 0);
+	return 1;
+}
+
+int
+recordstop(void)
+{
+	int ok;
+
+	if (!recordfile)
+		return 1;
+	ok = !ferror(recordfile);
+	ok = !fclose(recordfile) && ok;
+	recordfile = NULL;
+	return ok;
+}
+
+void
+recordu32(uint32_t v)
+{
+	recordput(&v, sizeof(v));
+}
+
+/* what manage() and the systray ask of a new window */
+void
+recordwindow(Window w)
+{
+	XWindowAttributes wa;
+	Atom *props;
+	int i, n;
+
+	if (!XGetWindowAttributes(dpy, w, &wa))
+		return;
+	if ((props = XListProperties(dpy, w, &n))) {
+		for (i = 0; i < n; i++)
+			recordprop(w, props[i]);
+		XFree(props);
+	}
+	putc('w', recordfile);
+	recordu32(w);
+	recordu32(winpid(w));
+	recordu32(wa.x);
+	recordu32(wa.y);
+	recordu32(wa.width);
+	recordu32(wa.height);
+	recordu32(wa.border_width);
+}
+
+int
+replay(const char *path)
+{
+	char magic[4];
+	uint32_t version, n, v, i;
+	unsigned long nevents = 0, nrepaints = 0;
+	long long t;
+	int kind = 0;
+	XEvent ev;
+
+	if (!(replayfile = fopen(path, "r"))) {
+		fprintf(stderr, "dwm: cannot open '%s': %s\n", path, strerror(errno));
+		return 0;
+	}
+	if (!replayget(magic, 4) || memcmp(magic, "DWMR", 4)
+	|| !replayget(&version, 4) || version != RECORDVERSION
+	|| !replayget(&v, 4) || !replayget(&n, 4)) {
+		fprintf(stderr, "dwm: '%s' is not a recording of this version\n", path);
+		fclose(replayfile);
+		return 0;
+	}
+	replayroot = v;
+	replaybars = ecalloc(MAX(n, 1), sizeof(Window));
+	for (nreplaybars = 0; nreplaybars < n && replayget(&v, 4); nreplaybars++)
+		replaybars[nreplaybars] = v;
+	if (replayget(&v, 4))
+		replaysystray = v;
+
+	replaying = 1;
+	XSync(dpy, False);
+	t = statsnow();
+	while (running && (kind = replayread(&ev)) > 0) {
+		if (kind == 'r') {
+			repaint();
+			nrepaints++;
+		} else {
+			dispatch(&ev);
+			if (ev.type == DestroyNotify)
+				replaydestroy(ev.xdestroywindow.window);
+			nevents++;
+		}
+		while (XPending(dpy))
+			XNextEvent(dpy, &ev);
+	}
+	t = statsnow() - t;
+	replaying = 0;
+
+	fprintf(stderr, "dwm: replayed %lu events and %lu repaints in %lld.%03lld ms\n",
+		nevents, nrepaints, t / 1000000, t / 1000 % 1000);
+	if (running && kind < 0)
+		fprintf(stderr, "dwm: '%s' is truncated or corrupt\n", path);
+	if (stats)
+		statslog();
+	if (tracing)
+		tracelog();
+	for (i = 0; i < replaywins.n; i++)
+		if (replaywins.v[i].to)
+			XDestroyWindow(dpy, replaywins.v[i].to);
+	free(replaywins.v);
+	free(replayatoms.v);
+	free(replaybars);
+	fclose(replayfile);
+	return !running || kind == 0;
+}
+
+Atom
+replayatom(Atom a)
+{
+	unsigned int i;
+
+	if (a <= XA_LAST_PREDEFINED)
+		return a;
+	for (i = 0; i < replayatoms.n; i++)
+		if (replayatoms.v[i].from == a)
+			return replayatoms.v[i].to;
+	return a;
+}
+
+/* the recorded window is gone and its id may come back as a new one */
+void
+replaydestroy(Window w)
+{
+	unsigned int i;
+
+	for (i = 0; i < replaywins.n; i++)
+		if (replaywins.v[i].to == w) {
+			XDestroyWindow(dpy, w);
+			replaywins.v[i].to = None;
+			replaywins.v[i].pid = 0;
+		}
+}
+
+ReplayEntry *
+replayfind(ReplayMap *map, unsigned long from)
+{
+	unsigned int i;
+
+	for (i = 0; i < map->n; i++)
+		if (map->v[i].from == from)
+			return &map->v[i];
+	if (map->n == map->size) {
+		map->size = map->size ? 2 * map->size : 64;
+		if (!(map->v = realloc(map->v, map->size * sizeof(ReplayEntry))))
+			die("realloc:");
+	}
+	map->v[map->n] = (ReplayEntry){ .from = from };
+	return &map->v[map->n++];
+}
+
+int
+replayget(void *data, size_t len)
+{
+	return fread(data, 1, len, replayfile) == len;
+}
+
+pid_t
+replaypid(Window w)
+{
+	unsigned int i;
+
+	for (i = 0; i < replaywins.n; i++)
+		if (replaywins.v[i].to == w)
+			return replaywins.v[i].pid;
+	return 0;
+}
+
+/* applies the records up to the next event or repaint and returns its kind,
+ * 0 at the end of the file or -1 if the file is broken */
+int
+replayread(XEvent *ev)
+{
+	char name[0x10000];
+	unsigned char format, *data;
+	uint16_t len, size;
+	uint32_t w, a, type, n, geom[5];
+	uint64_t t;
+	unsigned long i;
+	long *l;
+	int kind;
+
+	if ((kind = replaypending)) {
+		replaypending = 0;
+		*ev = replaypendingev;
+		return kind;
+	}
+	while ((kind = getc(replayfile)) != EOF) {
+		switch (kind) {
+		case 'a':
+			if (!replayget(&a, 4) || !replayget(&len, 2) || !replayget(name, len))
+				return -1;
+			name[len] = '\0';
+			replayfind(&replayatoms, a)->to = XInternAtom(dpy, name, False);
+			break;
+		case 'p':
+			if (!replayget(&w, 4) || !replayget(&a, 4) || !replayget(&type, 4)
+			|| !replayget(&format, 1) || !replayget(&n, 4)
+			|| (format != 8 && format != 16 && format != 32))
+				return -1;
+			data = ecalloc(MAX(n, 1), format == 32 ? sizeof(long) : format / 8);
+			if (!replayget(data, (size_t)n * (format / 8))) {
+				free(data);
+				return -1;
+			}
+			/* widened in place, from the back */
+			if (format == 32)
+				for (i = n, l = (long *)data; i-- > 0;)
+					l[i] = type == XA_ATOM ? replayatom(((uint32_t *)data)[i]) : ((uint32_t *)data)[i];
+			XChangeProperty(dpy, replaywin(w), replayatom(a), replayatom(type), format,
+				PropModeReplace, data, n);
+			free(data);
+			break;
+		case 'w':
+			if (!replayget(&w, 4) || !replayget(&a, 4) || !replayget(geom, sizeof(geom)))
+				return -1;
+			XMoveResizeWindow(dpy, replaywin(w), (int32_t)geom[0], (int32_t)geom[1],
+				MAX(geom[2], 1), MAX(geom[3], 1));
+			XSetWindowBorderWidth(dpy, replaywin(w), geom[4]);
+			replayfind(&replaywins, w)->pid = a;
+			break;
+		case 'e':
+		case 'm':
+			if (!replayget(&t, 8) || getc(replayfile) == EOF || !replayget(&size, 2)
+			|| size > sizeof(XEvent))
+				return -1;
+			memset(ev, 0, sizeof(*ev));
+			if (!replayget(ev, size) || ev->type >= LASTEvent)
+				return -1;
+			replaytranslate(ev);
+			if (ev->type == PropertyNotify && ev->xproperty.state == PropertyDelete)
+				XDeleteProperty(dpy, ev->xproperty.window, ev->xproperty.atom);
+			return kind;
+		case 'r':
+			return kind;
+		default:
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void
+replaytranslate(XEvent *ev)
+{
+	int i;
+
+	ev->xany.display = dpy;
+	ev->xany.window = replaywin(ev->xany.window);
+	switch (ev->type) {
+	case KeyPress:
+	case KeyRelease:
+		ev->xkey.root = replaywin(ev->xkey.root);
+		ev->xkey.subwindow = replaywin(ev->xkey.subwindow);
+		break;
+	case ButtonPress:
+	case ButtonRelease:
+		ev->xbutton.root = replaywin(ev->xbutton.root);
+		ev->xbutton.subwindow = replaywin(ev->xbutton.subwindow);
+		break;
+	case MotionNotify:
+		ev->xmotion.root = replaywin(ev->xmotion.root);
+		ev->xmotion.subwindow = replaywin(ev->xmotion.subwindow);
+		break;
+	case EnterNotify:
+	case LeaveNotify:
+		ev->xcrossing.root = replaywin(ev->xcrossing.root);
+		ev->xcrossing.subwindow = replaywin(ev->xcrossing.subwindow);
+		break;
+	case DestroyNotify:
+		ev->xdestroywindow.window = replaywin(ev->xdestroywindow.window);
+		break;
+	case UnmapNotify:
+		ev->xunmap.window = replaywin(ev->xunmap.window);
+		break;
+	case MapNotify:
+		ev->xmap.window = replaywin(ev->xmap.window);
+		break;
+	case MapRequest:
+		ev->xmaprequest.window = replaywin(ev->xmaprequest.window);
+		break;
+	case ConfigureNotify:
+		ev->xconfigure.window = replaywin(ev->xconfigure.window);
+		ev->xconfigure.above = replaywin(ev->xconfigure.above);
+		break;
+	case ConfigureRequest:
+		ev->xconfigurerequest.window = replaywin(ev->xconfigurerequest.window);
+		ev->xconfigurerequest.above = replaywin(ev->xconfigurerequest.above);
+		break;
+	case PropertyNotify:
+		ev->xproperty.atom = replayatom(ev->xproperty.atom);
+		break;
+	case ClientMessage:
+		ev->xclient.message_type = replayatom(ev->xclient.message_type);
+		if (ev->xclient.format != 32)
+			break;
+		for (i = 0; i < 5; i++)
+			ev->xclient.data.l[i] = replayatom(ev->xclient.data.l[i]);
+		if (ev->xclient.message_type == netatom[NetSystemTrayOP])
+			ev->xclient.data.l[2] = replaywin(ev->xclient.data.l[2]);
+		break;
+	}
+}
+
+/* the stand-in for a recorded window */
+Window
+replaywin(Window w)
+{
+	unsigned int i;
+	Monitor *m;
+	ReplayEntry *e;
+
+	if (w == None)
+		return None;
+	if (w == replayroot)
+		return root;
+	if (w == replaysystray && systray)
+		return systray->win;
+	for (i = 0, m = mons; i < nreplaybars && m; i++, m = m->next)
+		if (w == replaybars[i])
+			return m->barwin;
+	if (!(e = replayfind(&replaywins, w))->to)
+		e->to = XCreateSimpleWindow(dpy, root, 0, 0, 1, 1, 0, 0, 0);
+	return e->to;
+}
+
+#define XMaskEvent(...) recordmaskevent(__VA_ARGS__)
@@ -0,0 +1,440 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Bar rendering. renderbar() turns a monitor's bar into a BarSnap: the click
+ * regions are computed on the event thread and everything that is drawn is
+ * copied, so barpaint() does not look at clients or monitors.
+ *
+ * Without renderthread the snapshot is painted right away. With renderthread
+ * set in config.h, renderstart() opens a second X connection with a drw and
+ * fonts of its own, and a thread paints the snapshots it is handed through a
+ * lock-free single-producer ring. Text shaping, fallback font matching and
+ * icon compositing then never hold up the event thread. A snapshot that a
+ * newer one of the same bar overtook in the ring is dropped unpainted. When
+ * the ring is full, the bar stays dirty and the render thread wakes the event
+ * loop through renderfd once it has caught up.
+ *
+ * Xft keeps its per-display state in a global list that it reorders on
+ * lookup, so every Xft call goes through xfttext() and xftwidth(), which
+ * hold xftlock. The render thread takes it for one piece of text at a time.
+ * The trace and stats hooks behind drw_text() and drw_map() are only run on
+ * the event thread; the render thread calls drw directly.
+ */
+#include <pthread.h>
+#include <semaphore.h>
+
+#define RENDERQUEUESIZE 32 /* snapshots in flight */
+#define PAINTBEGIN(N) do { if (d == drw) TRACEBEGIN(N); } while (0)
+#define PAINTEND(N)   do { if (d == drw) TRACEEND(N); } while (0)
+
+typedef struct {
+	char name[256];
+	Picture icon;
+	unsigned int icw, ich;
+	int scm, isfloating, isfixed, issticky;
+} BarTab;
+
+typedef struct {
+	Window win;
+	int wbar;
+	int status, wstext;           /* status is drawn on the selected monitor */
+	char stext[STATUSLENGTH];
+	int alttag;
+	unsigned int tagset, occ, urg;
+	unsigned int seltags;         /* tags of the selected client, on selmon */
+	int tagw[LENGTH(tags)];
+	const char *attsymbol;
+	int attw;
+	char ltsymbol[16];
+	int ltw;
+	int titlew;
+	int trayw;                    /* systray on the left of the status */
+	unsigned int ntabs;
+	BarTab tabs[];
+} BarSnap;
+
+static void barpaint(Drw *d, BarSnap *b);
+static BarSnap *barsnap(Monitor *m);
+static Fnt *fontat(Fnt *f, int i);
+static void *renderloop(void *arg);
+static int renderpush(BarSnap *b);
+static void renderstart(void);
+static void renderstop(void);
+static int xfttext(Drw *d, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert);
+static unsigned int xftwidth(Drw *d, const char *text);
+
+static pthread_mutex_t xftlock = PTHREAD_MUTEX_INITIALIZER;
+static Display *renderdpy;
+static Drw *renderdrw;
+static pthread_t renderthr;
+static sem_t renderwake;
+static int renderfd[2] = { -1, -1 }; /* render thread to event loop, the ring has room */
+static int renderrunning;
+static BarSnap *renderq[RENDERQUEUESIZE];
+static unsigned int renderhead, rendertail; /* advanced by the event and render thread */
+static int renderstalled, renderquit;
+
+void
+barpaint(Drw *d, BarSnap *b)
+{
+	Fnt *fnt = d->fonts;
+	int x, w, boxs = fnt->h / 9, boxw = fnt->h / 6 + 2;
+	unsigned int i;
+	BarTab *t;
+
+	if (d->w < (unsigned int)b->wbar || d->h < (unsigned int)bh)
+		drw_resize(d, MAX(d->w, b->wbar), MAX(d->h, bh));
+
+	/* draw status first so it can be overdrawn by tags later */
+	if (b->status) {
+		char *stc = b->stext;
+		char *stp = b->stext;
+		char tmp;
+		int blkw;
+
+		PAINTBEGIN("drawbar status");
+		drw_setfontset(d, fontat(fnt, FontStatusMonitor));
+
+		drw_setscheme(d, scheme[SchemeNorm]);
+		x = b->wbar - b->wstext;
+		drw_rect(d, x, 0, LSPAD, bh, 1, 1); x += LSPAD; /* to keep left padding clean */
+		for (;;) {
+			if ((unsigned char)*stc >= ' ') {
+				stc++;
+				continue;
+			}
+			tmp = *stc;
+			if (stp != stc) {
+				*stc = '\0';
+				blkw = xftwidth(d, stp);
+				if (statustpad > 0)
+					drw_rect(d, x, 0, blkw, statustpad, 1, 1);
+				x = xfttext(d, x, statustpad, blkw, bh, 0, stp, 0);
+			}
+			if (tmp == '\0')
+				break;
+			if (tmp - DELIMITERENDCHAR - 1 < LENGTH(colors))
+				drw_setscheme(d, scheme[tmp - DELIMITERENDCHAR - 1]);
+			*stc = tmp;
+			stp = ++stc;
+		}
+		drw_setscheme(d, scheme[SchemeNorm]);
+		drw_rect(d, x, 0, b->wbar - x, bh, 1, 1); /* to keep right padding clean */
+
+		drw_setfontset(d, fnt);
+		PAINTEND("drawbar status");
+	}
+
+	PAINTBEGIN("drawbar tags");
+	for (i = 0, x = 0; i < LENGTH(tags); i++) {
+		drw_setscheme(d, scheme[b->tagset & 1 << i ? SchemeSel : SchemeNorm]);
+		xfttext(d, x, 0, b->tagw[i], bh, lrpad / 2, (b->alttag ? tagsalt[i] : tags[i]), b->urg & 1 << i);
+		if (b->occ & 1 << i)
+			drw_rect(d, x + boxs, boxs, boxw, boxw, b->seltags & 1 << i, b->urg & 1 << i);
+		x += b->tagw[i];
+	}
+	PAINTEND("drawbar tags");
+
+	PAINTBEGIN("drawbar layout");
+	drw_setscheme(d, scheme[SchemeNorm]);
+	x = xfttext(d, x, 0, b->attw, bh, lrpad / 2, b->attsymbol, 0);
+	x = xfttext(d, x + layoutlpad, layouttpad, b->ltw, bh, lrpad / 2, b->ltsymbol, 0);
+	PAINTEND("drawbar layout");
+
+	PAINTBEGIN("drawbar titles");
+	if ((w = b->titlew) > bh) {
+		drw_setfontset(d, fontat(fnt, FontWindowTitle));
+
+		if (b->ntabs > 0) {
+			int remainder = w % b->ntabs + 1;
+			int tabw = w / b->ntabs + 1;
+			int stw = boxw | 1;
+			for (i = 0; i < b->ntabs; i++) {
+				t = &b->tabs[i];
+				drw_setscheme(d, scheme[t->scm]);
+
+				if (--remainder == 0)
+						tabw--;
+				if (windowtitletpad > 0)
+					drw_rect(d, x, 0, tabw, windowtitletpad, 1, 1);
+				#if SHOWWINICON
+				xfttext(d, x, windowtitletpad, tabw, bh, lrpad / 2 + (t->icon ? t->icw + ICONSPACING : 0), t->name, 0);
+				if (t->icon)
+					drw_pic(d, x + lrpad / 2, (bh - t->ich) / 2, t->icw, t->ich, t->icon);
+				#else
+				xfttext(d, x, windowtitletpad, tabw, bh, lrpad / 2, t->name, 0);
+				#endif
+				if (t->isfloating) {
+					drw_rect(d, x + boxs, boxs, boxw, boxw, t->isfixed, 0);
+				}
+				if (t->issticky) {
+					drw_rect(d, x + boxs, bh - boxs - stw/2 - 1, stw, 1, 1, 0);
+					drw_rect(d, x + boxs + stw/2, bh - boxs - stw, 1, stw, 1, 0);
+				}
+				x += tabw;
+			}
+		} else {
+			drw_setscheme(d, scheme[SchemeNorm]);
+			drw_rect(d, x, 0, w, bh, 1, 1);
+			x += w;
+		}
+		/* keep systray area clean */
+		if (b->trayw) {
+			drw_setscheme(d, scheme[SchemeNorm]);
+			drw_rect(d, x, 0, b->trayw, bh, 1, 1);
+		}
+
+		drw_setfontset(d, fnt);
+	}
+	PAINTEND("drawbar titles");
+
+	if (d == drw)
+		drw_map(d, b->win, 0, 0, b->wbar, bh);
+	else
+		(drw_map)(d, b->win, 0, 0, b->wbar, bh);
+}
+
+/* runs on the event thread: updates the click regions and copies what
+ * barpaint() draws */
+BarSnap *
+barsnap(Monitor *m)
+{
+	BarSnap *b;
+	BarTab *t;
+	Client *c;
+	unsigned int i, n = 0;
+	int x;
+
+	for (c = m->clients; c; c = c->next)
+		if (ISVISIBLE(c))
+			n++;
+	b = ecalloc(1, sizeof(BarSnap) + n * sizeof(BarTab));
+	b->win = m->barwin;
+	b->wbar = m->ww;
+	if (showsystray && !systrayonleft && m == systraytomon(m))
+		b->wbar -= getsystraywidth();
+	if ((b->status = m == selmon)) {
+		wsbar = b->wbar;
+		b->wstext = wstext;
+		memcpy(b->stext, stextc, sizeof(b->stext));
+	}
+
+	for (c = m->clients; c; c = c->next) {
+		b->occ |= c->tags;
+		if (c->isurgent)
+			b->urg |= c->tags;
+	}
+	b->alttag = selmon->alttag;
+	b->tagset = m->tagset[m->seltags];
+	if (m == selmon && selmon->sel)
+		b->seltags = selmon->sel->tags;
+	for (i = 0, x = 0; i < LENGTH(tags); i++)
+		x += b->tagw[i] = TEXTW(tags[i]);
+	bte = x;
+
+	b->attsymbol = m->att[m->selatt]->symbol;
+	x += b->attw = TEXTW(b->attsymbol);
+	bae = x;
+	memcpy(b->ltsymbol, m->ltsymbol, sizeof(b->ltsymbol));
+	x += layoutlpad + (b->ltw = TEXTW(b->ltsymbol));
+	ble = x;
+
+	b->titlew = b->wbar - x - (m == selmon ? wstext : 0);
+	if (showsystray && systrayonleft && m == systraytomon(m))
+		b->titlew -= b->trayw = getsystraywidth();
+	for (c = m->clients, t = b->tabs; c; c = c->next) {
+		if (!ISVISIBLE(c))
+			continue;
+		if (m->sel == c)
+			t->scm = m->hidsel ? SchemeHidSel : SchemeTitleSel;
+		else if (HIDDEN(c))
+			t->scm = SchemeHid;
+		else
+			t->scm = SchemeTitle;
+		memcpy(t->name, c->name, sizeof(t->name));
+		t->icon = c->icon;
+		t->icw = c->icw;
+		t->ich = c->ich;
+		t->isfloating = c->isfloating;
+		t->isfixed = c->isfixed;
+		t->issticky = c->issticky;
+		t++;
+	}
+	b->ntabs = n;
+
+	m->bt = n;
+	m->btw = b->titlew;
+	return b;
+}
+
+Fnt *
+fontat(Fnt *f, int i)
+{
+	for (; i > 0 && f->next; i--, f = f->next);
+	return f;
+}
+
+void
+renderbar(Monitor *m)
+{
+	BarSnap *b;
+
+	m->bardirty = 0;
+	if (!m->showbar)
+		return;
+	TRACEBEGIN("drawbar");
+	b = barsnap(m);
+	XMoveResizeWindow(dpy, m->barwin, m->wx, m->by, b->wbar, bh);
+	if (!renderrunning) {
+		barpaint(drw, b);
+		free(b);
+	} else if (!renderpush(b)) {
+		free(b);
+		m->bardirty = 1; /* retried when renderfd reports room */
+	}
+	refreshsystray();
+	TRACEEND("drawbar");
+}
+
+void *
+renderloop(void *arg)
+{
+	BarSnap *b[RENDERQUEUESIZE];
+	unsigned int i, j, n, t;
+
+	for (;;) {
+		sem_wait(&renderwake);
+		if (__atomic_load_n(&renderquit, __ATOMIC_SEQ_CST))
+			break;
+		t = rendertail;
+		for (n = 0; t != __atomic_load_n(&renderhead, __ATOMIC_ACQUIRE); t++)
+			b[n++] = renderq[t % RENDERQUEUESIZE];
+		if (!n)
+			continue;
+		__atomic_store_n(&rendertail, t, __ATOMIC_SEQ_CST);
+		if (__atomic_exchange_n(&renderstalled, 0, __ATOMIC_SEQ_CST))
+			while (write(renderfd[1], "", 1) == -1 && errno == EINTR);
+		for (i = 0; i < n; i++) {
+			for (j = i + 1; j < n && b[j]->win != b[i]->win; j++);
+			if (j == n)
+				barpaint(renderdrw, b[i]);
+			free(b[i]);
+		}
+	}
+	return NULL;
+}
+
+/* WatchRender */
+void
+renderread(int fd)
+{
+	char buf[64];
+
+	/* the dirty bars are snapshotted again by the next repaint() */
+	while (read(fd, buf, sizeof(buf)) > 0);
+}
+
+/* hands b to the render thread, returns 0 if the ring is full */
+int
+renderpush(BarSnap *b)
+{
+	unsigned int h = renderhead;
+
+	if (h - __atomic_load_n(&rendertail, __ATOMIC_SEQ_CST) == RENDERQUEUESIZE) {
+		/* ask for a wakeup, unless the thread made room in the meantime */
+		__atomic_store_n(&renderstalled, 1, __ATOMIC_SEQ_CST);
+		if (h - __atomic_load_n(&rendertail, __ATOMIC_SEQ_CST) == RENDERQUEUESIZE)
+			return 0;
+	}
+	renderq[h % RENDERQUEUESIZE] = b;
+	__atomic_store_n(&renderhead, h + 1, __ATOMIC_RELEASE);
+	sem_post(&renderwake);
+	return 1;
+}
+
+void
+renderstart(void)
+{
+	sigset_t all, old;
+	int i, err;
+
+	if (!renderthread)
+		return;
+	if (!(renderdpy = XOpenDisplay(DisplayString(dpy)))) {
+		fputs("dwm: cannot open a render connection, bars are drawn by the event loop\n", stderr);
+		return;
+	}
+	fcntl(ConnectionNumber(renderdpy), F_SETFD, FD_CLOEXEC);
+	renderdrw = drw_create(renderdpy, screen, RootWindow(renderdpy, screen), sw, bh);
+	if (!drw_fontset_create(renderdrw, fonts, LENGTH(fonts)) || pipe(renderfd) == -1) {
+		fputs("dwm: cannot set up the render thread, bars are drawn by the event loop\n", stderr);
+		renderstop();
+		return;
+	}
+	for (i = 0; i < 2; i++) {
+		fcntl(renderfd[i], F_SETFD, FD_CLOEXEC);
+		fcntl(renderfd[i], F_SETFL, O_NONBLOCK);
+	}
+	sem_init(&renderwake, 0, 0);
+	/* signals are handled by the event loop */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	err = pthread_create(&renderthr, NULL, renderloop, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err) {
+		fprintf(stderr, "dwm: cannot start the render thread: %s\n", strerror(err));
+		sem_destroy(&renderwake);
+		renderstop();
+		return;
+	}
+	renderrunning = 1;
+	watchfd(renderfd[0], WatchRender);
+}
+
+void
+renderstop(void)
+{
+	if (renderrunning) {
+		__atomic_store_n(&renderquit, 1, __ATOMIC_SEQ_CST);
+		sem_post(&renderwake);
+		pthread_join(renderthr, NULL);
+		renderrunning = 0;
+		for (; rendertail != renderhead; rendertail++)
+			free(renderq[rendertail % RENDERQUEUESIZE]);
+		sem_destroy(&renderwake);
+		unwatchfd(renderfd[0]);
+	}
+	if (renderfd[0] != -1) {
+		close(renderfd[0]);
+		close(renderfd[1]);
+		renderfd[0] = renderfd[1] = -1;
+	}
+	if (renderdrw)
+		drw_free(renderdrw);
+	renderdrw = NULL;
+	if (renderdpy)
+		XCloseDisplay(renderdpy);
+	renderdpy = NULL;
+}
+
+int
+xfttext(Drw *d, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert)
+{
+	pthread_mutex_lock(&xftlock);
+	if (d == drw)
+		x = drw_text(d, x, y, w, h, lpad, text, invert);
+	else
+		x = (drw_text)(d, x, y, w, h, lpad, text, invert);
+	pthread_mutex_unlock(&xftlock);
+	return x;
+}
+
+unsigned int
+xftwidth(Drw *d, const char *text)
+{
+	unsigned int w;
+
+	pthread_mutex_lock(&xftlock);
+	w = drw_fontset_getwidth(d, text);
+	pthread_mutex_unlock(&xftlock);
+	return w;
+}
@@ -0,0 +1,178 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Rule matching. A rule matches when each of its class, instance and title
+ * strings occurs somewhere in the window's (strstr semantics, NULL or ""
+ * matching anything). At startup the patterns of each field are compiled
+ * into one Aho-Corasick automaton, a DFA over the bytes that occur in the
+ * patterns, so matching a window reads each of its three strings once
+ * however many rules there are. A rule found in every field it names is a
+ * match; rules that name no field always match. rulesfind() returns the
+ * matches in rules[] order, the order applyrules() applies them in.
+ */
+
+enum { RuleClass, RuleInstance, RuleTitle, RuleLast }; /* rule fields */
+
+typedef struct {
+	unsigned char cls[256]; /* byte -> character class, 0 for bytes in no pattern */
+	unsigned int nclasses;
+	unsigned int *next;     /* state * nclasses + class -> state, state 0 is the root */
+	int *out;               /* a rule whose pattern ends in the state, or -1 */
+	unsigned int *dict;     /* nearest state on the fail chain with an output, or 0 */
+} RuleMatcher;
+
+static void rulescompile(void);
+static const char *rulesfield(const Rule *r, int field);
+static unsigned int rulesfind(const char *fields[RuleLast], unsigned int *matched);
+static void rulesfree(void);
+static void rulesscan(int field, const char *s, unsigned int *cand, unsigned int *ncand);
+
+static RuleMatcher rulematchers[RuleLast];
+static int rulenext[RuleLast][LENGTH(rules)];         /* next rule with the same pattern */
+static unsigned char ruleneed[LENGTH(rules)];         /* fields the rule names */
+static unsigned char rulegot[LENGTH(rules)];          /* fields matched so far */
+static unsigned int rulesalways[LENGTH(rules)], nrulesalways;
+
+void
+rulescompile(void)
+{
+	const unsigned char *p;
+	unsigned int f, i, c, s, t, n, nc, size, head, tail, *fail, *queue;
+	RuleMatcher *m;
+
+	for (i = 0; i < LENGTH(rules); i++) {
+		ruleneed[i] = 0;
+		for (f = 0; f < RuleLast; f++)
+			if ((p = (const unsigned char *)rulesfield(&rules[i], f)) && *p)
+				ruleneed[i] |= 1 << f;
+		if (!ruleneed[i])
+			rulesalways[nrulesalways++] = i;
+	}
+
+	for (f = 0; f < RuleLast; f++) {
+		m = &rulematchers[f];
+		m->nclasses = 1;
+		for (i = 0, size = 1; i < LENGTH(rules); i++)
+			if ((p = (const unsigned char *)rulesfield(&rules[i], f)))
+				for (; *p; p++, size++)
+					if (!m->cls[*p])
+						m->cls[*p] = m->nclasses++;
+		if (size == 1)
+			continue;
+		nc = m->nclasses;
+		m->next = ecalloc(size * nc, sizeof(unsigned int));
+		m->out = ecalloc(size, sizeof(int));
+		m->dict = ecalloc(size, sizeof(unsigned int));
+		for (s = 0; s < size; s++)
+			m->out[s] = -1;
+
+		/* the trie; 0 means no edge, as the root is nobody's child */
+		for (i = 0, n = 1; i < LENGTH(rules); i++) {
+			if (!(p = (const unsigned char *)rulesfield(&rules[i], f)) || !*p)
+				continue;
+			for (s = 0; *p; p++) {
+				c = m->cls[*p];
+				if (!m->next[s * nc + c])
+					m->next[s * nc + c] = n++;
+				s = m->next[s * nc + c];
+			}
+			rulenext[f][i] = m->out[s];
+			m->out[s] = i;
+		}
+
+		/* fail links breadth first, turning missing edges into the
+		 * edges of the fail state */
+		fail = ecalloc(n, sizeof(unsigned int));
+		queue = ecalloc(n, sizeof(unsigned int));
+		for (c = head = tail = 0; c < nc; c++)
+			if ((t = m->next[c]))
+				queue[tail++] = t;
+		while (head < tail) {
+			s = queue[head++];
+			for (c = 0; c < nc; c++) {
+				if (!(t = m->next[s * nc + c])) {
+					m->next[s * nc + c] = m->next[fail[s] * nc + c];
+					continue;
+				}
+				fail[t] = m->next[fail[s] * nc + c];
+				m->dict[t] = m->out[fail[t]] >= 0 ? fail[t] : m->dict[fail[t]];
+				queue[tail++] = t;
+			}
+		}
+		free(fail);
+		free(queue);
+	}
+}
+
+const char *
+rulesfield(const Rule *r, int field)
+{
+	switch (field) {
+	case RuleClass:    return r->class;
+	case RuleInstance: return r->instance;
+	default:           return r->title;
+	}
+}
+
+/* stores the indices of the matching rules in matched, in ascending order,
+ * and returns how many there are */
+unsigned int
+rulesfind(const char *fields[RuleLast], unsigned int *matched)
+{
+	unsigned int cand[LENGTH(rules)];
+	unsigned int i, j, r, n = 0, ncand = 0;
+	int f;
+
+	for (f = 0; f < RuleLast; f++)
+		rulesscan(f, fields[f], cand, &ncand);
+	for (i = 0; i < ncand; i++) {
+		if (rulegot[cand[i]] == ruleneed[cand[i]])
+			matched[n++] = cand[i];
+		rulegot[cand[i]] = 0;
+	}
+	for (i = 0; i < nrulesalways; i++)
+		matched[n++] = rulesalways[i];
+	for (i = 1; i < n; i++) {
+		for (r = matched[i], j = i; j > 0 && matched[j - 1] > r; j--)
+			matched[j] = matched[j - 1];
+		matched[j] = r;
+	}
+	return n;
+}
+
+void
+rulesfree(void)
+{
+	int f;
+
+	for (f = 0; f < RuleLast; f++) {
+		free(rulematchers[f].next);
+		free(rulematchers[f].out);
+		free(rulematchers[f].dict);
+	}
+	memset(rulematchers, 0, sizeof(rulematchers));
+	nrulesalways = 0;
+}
+
+/* marks the rules whose pattern for field occurs in s, adding the ones not
+ * seen before to cand */
+void
+rulesscan(int field, const char *s, unsigned int *cand, unsigned int *ncand)
+{
+	RuleMatcher *m = &rulematchers[field];
+	const unsigned char *p;
+	unsigned int st = 0, d;
+	int r;
+
+	if (!m->next)
+		return;
+	for (p = (const unsigned char *)s; *p; p++) {
+		st = m->next[st * m->nclasses + m->cls[*p]];
+		for (d = m->out[st] >= 0 ? st : m->dict[st]; d; d = m->dict[d])
+			for (r = m->out[d]; r >= 0; r = rulenext[field][r])
+				if (!(rulegot[r] & 1 << field)) {
+					if (!rulegot[r])
+						cand[(*ncand)++] = r;
+					rulegot[r] |= 1 << field;
+				}
+	}
+}
@@ -0,0 +1,169 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Process creation. Commands are started with posix_spawnp(), which on
+ * glibc and the BSDs shares the address space with the child until it
+ * execs, so the cost of a spawn does not grow with dwm's memory. The child
+ * gets the signal mask dwm started with and a session of its own, or a
+ * process group of its own where posix_spawn cannot make sessions.
+ *
+ * With spawnlauncher set in config.h, setup() forks a launcher once the
+ * environment, including DWM_SOCKET, is final. The launcher closes the
+ * descriptors it inherited from dwm. spawn() then only sends the argv over
+ * a socket, and the launcher, small and in its own session, spawns the
+ * command and reaps it. If the launcher is gone or the argv does not fit
+ * in one message, dwm spawns the command itself.
+ */
+
+#define SPAWNMSGSIZE 4096 /* bytes of argv one launcher message carries */
+#define SPAWNMAXARGS 256
+
+extern char **environ;
+
+static void spawncleanup(void);
+static int spawnlaunch(char *const argv[]);
+static pid_t spawnproc(char *const argv[], const posix_spawn_file_actions_t *fa);
+static void spawnserve(int fd);
+static void spawnsetup(void);
+
+static int launcherfd = -1;
+
+void
+spawncleanup(void)
+{
+	if (launcherfd >= 0)
+		close(launcherfd); /* the launcher exits on end of file */
+	launcherfd = -1;
+}
+
+/* hands argv to the launcher, returns 0 if dwm has to spawn it itself */
+int
+spawnlaunch(char *const argv[])
+{
+	char buf[SPAWNMSGSIZE];
+	size_t len = 0, n;
+	int i, flags = 0;
+
+	if (launcherfd < 0)
+		return 0;
+	for (i = 0; argv[i]; i++) {
+		if (i == SPAWNMAXARGS || (n = strlen(argv[i]) + 1) > sizeof(buf) - len)
+			return 0;
+		memcpy(buf + len, argv[i], n);
+		len += n;
+	}
+#ifdef MSG_NOSIGNAL
+	flags = MSG_NOSIGNAL;
+#endif
+	if (send(launcherfd, buf, len, flags) == (ssize_t)len)
+		return 1;
+	spawncleanup();
+	return 0;
+}
+
+pid_t
+spawnproc(char *const argv[], const posix_spawn_file_actions_t *fa)
+{
+	posix_spawnattr_t attr;
+	sigset_t dfl;
+	short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+	pid_t pid;
+	int err;
+
+#ifdef POSIX_SPAWN_SETSID
+	flags |= POSIX_SPAWN_SETSID;
+#else
+	flags |= POSIX_SPAWN_SETPGROUP;
+#endif
+	sigemptyset(&dfl);
+	sigaddset(&dfl, SIGCHLD);
+	sigaddset(&dfl, SIGPIPE);
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setflags(&attr, flags);
+	posix_spawnattr_setsigdefault(&attr, &dfl);
+	posix_spawnattr_setsigmask(&attr, &origsigmask);
+	if ((err = posix_spawnp(&pid, argv[0], fa, &attr, argv, environ))) {
+		fprintf(stderr, "dwm: cannot spawn '%s': %s\n", argv[0], strerror(err));
+		pid = -1;
+	}
+	posix_spawnattr_destroy(&attr);
+	return pid;
+}
+
+void
+spawnserve(int fd)
+{
+	char buf[SPAWNMSGSIZE + 1], *argv[SPAWNMAXARGS + 1];
+	struct sigaction sa;
+	ssize_t n;
+	size_t i;
+	int argc;
+
+	setsid();
+	/* undo the signal handling setup() did for dwm; the commands are
+	 * reaped by the kernel and spawnproc() restores SIGCHLD */
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sa.sa_handler = SIG_DFL;
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+	sigaction(SIGUSR1, &sa, NULL);
+	sigaction(SIGUSR2, &sa, NULL);
+	sa.sa_flags = SA_NOCLDWAIT;
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGCHLD, &sa, NULL);
+	sigprocmask(SIG_SETMASK, &origsigmask, NULL);
+
+	for (;;) {
+		if ((n = recv(fd, buf, SPAWNMSGSIZE, 0)) < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		buf[n] = '\0';
+		for (i = 0, argc = 0; i < (size_t)n && argc < SPAWNMAXARGS; i += strlen(buf + i) + 1)
+			argv[argc++] = buf + i;
+		argv[argc] = NULL;
+		if (argc)
+			spawnproc(argv, NULL);
+	}
+}
+
+void
+spawnsetup(void)
+{
+	/* everything setup() has opened by now, none of it is the launcher's */
+	int fds[] = {
+		ConnectionNumber(dpy), sigfd[0], sigfd[1], ipcfd, dsblockswatch,
+#if defined(__linux__)
+		epollfd, timerfd,
+#endif /* __linux__ */
+	};
+	int sv[2];
+	size_t i;
+
+	if (!spawnlauncher)
+		return;
+#ifdef SOCK_CLOEXEC
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1)
+		return;
+#else
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == -1)
+		return;
+	fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+	fcntl(sv[1], F_SETFD, FD_CLOEXEC);
+#endif
+	switch (fork()) {
+	case -1:
+		close(sv[0]);
+		close(sv[1]);
+		return;
+	case 0:
+		close(sv[0]);
+		for (i = 0; i < LENGTH(fds); i++)
+			if (fds[i] >= 0)
+				close(fds[i]);
+		spawnserve(sv[1]);
+		_exit(0);
+	}
+	close(sv[1]);
+	launcherfd = sv[0];
+}
@@ -0,0 +1,232 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Latency statistics for the event loop. While enabled (statsenabled in
+ * config.h, or "stats on" over the control socket) every X event handler and
+ * every keys[] and buttons[] action is timed into a histogram, and the length
+ * of the event queue is sampled each time an event is taken off it. Disabled,
+ * it costs one branch per event.
+ *
+ * Each timed section also gets the X traffic it caused: requests issued
+ * (from the Xlib request serial), round trips (the calls wrapped below, which
+ * block on a reply), and bytes written to and read from the connection. Xlib
+ * buffers output, so bytes are counted when they reach the socket and may land
+ * on a later section than the requests that produced them.
+ *
+ * "stats" over the socket returns the numbers as "ok <length>" followed by
+ * length bytes of text, SIGUSR1 writes the same text to stderr, "stats reset"
+ * clears them. Each line is
+ *
+ *     <kind> <name> <count> <mean> <p50> <p99> <max> <requests> <roundtrips>
+ *         <sent> <received>
+ *
+ * with kind one of event, key, button, loop (bar painting and subscriber
+ * updates after each burst of events) or queue. Times are in microseconds;
+ * for queue the values are event counts. p50 and p99 are the upper bounds of
+ * the power-of-two histogram buckets they fall into. The X columns are totals.
+ */
+
+#define STATBUCKETS 32
+
+typedef struct {
+	unsigned long long count, total, max;
+	unsigned long long hist[STATBUCKETS]; /* bucket b holds values below 2^b */
+	unsigned long long requests, roundtrips, sent, received;
+} Stat;
+
+typedef struct {
+	long long t;
+	unsigned long requests, roundtrips;
+	uint64_t sent, received;
+} StatMark;
+
+static void statsbegin(StatMark *mark);
+static void statsdump(IpcBuf *b);
+static void statsend(Stat *s, StatMark *mark);
+static void statsline(IpcBuf *b, const char *kind, const char *name, Stat *s);
+static void statslog(void);
+static long long statsnow(void);
+static unsigned long long statspercentile(Stat *s, unsigned int pct);
+static void statsrecord(Stat *s, unsigned long long v);
+static void statsreset(void);
+
+static const char *evnames[LASTEvent] = {
+	[KeyPress] = "KeyPress",
+	[KeyRelease] = "KeyRelease",
+	[ButtonPress] = "ButtonPress",
+	[ButtonRelease] = "ButtonRelease",
+	[MotionNotify] = "MotionNotify",
+	[EnterNotify] = "EnterNotify",
+	[LeaveNotify] = "LeaveNotify",
+	[FocusIn] = "FocusIn",
+	[FocusOut] = "FocusOut",
+	[KeymapNotify] = "KeymapNotify",
+	[Expose] = "Expose",
+	[GraphicsExpose] = "GraphicsExpose",
+	[NoExpose] = "NoExpose",
+	[VisibilityNotify] = "VisibilityNotify",
+	[CreateNotify] = "CreateNotify",
+	[DestroyNotify] = "DestroyNotify",
+	[UnmapNotify] = "UnmapNotify",
+	[MapNotify] = "MapNotify",
+	[MapRequest] = "MapRequest",
+	[ReparentNotify] = "ReparentNotify",
+	[ConfigureNotify] = "ConfigureNotify",
+	[ConfigureRequest] = "ConfigureRequest",
+	[GravityNotify] = "GravityNotify",
+	[ResizeRequest] = "ResizeRequest",
+	[CirculateNotify] = "CirculateNotify",
+	[CirculateRequest] = "CirculateRequest",
+	[PropertyNotify] = "PropertyNotify",
+	[SelectionClear] = "SelectionClear",
+	[SelectionRequest] = "SelectionRequest",
+	[SelectionNotify] = "SelectionNotify",
+	[ColormapNotify] = "ColormapNotify",
+	[ClientMessage] = "ClientMessage",
+	[MappingNotify] = "MappingNotify",
+	[GenericEvent] = "GenericEvent",
+};
+
+static Stat evstats[LASTEvent];
+static Stat keystats[LENGTH(keys)];
+static Stat buttonstats[LENGTH(buttons)];
+static Stat renderstats;
+static Stat queuestats;
+static unsigned long statsroundtrips;
+
+/* the blocking calls dwm makes; everything after this point is counted */
+#define XGetClassHint(...)         (statsroundtrips++, XGetClassHint(__VA_ARGS__))
+#define XGetKeyboardMapping(...)   (statsroundtrips++, XGetKeyboardMapping(__VA_ARGS__))
+#define XGetModifierMapping(...)   (statsroundtrips++, XGetModifierMapping(__VA_ARGS__))
+#define XGetSelectionOwner(...)    (statsroundtrips++, XGetSelectionOwner(__VA_ARGS__))
+#define XGetTextProperty(...)      (statsroundtrips++, XGetTextProperty(__VA_ARGS__))
+#define XGetTransientForHint(...)  (statsroundtrips++, XGetTransientForHint(__VA_ARGS__))
+#define XGetWindowAttributes(...)  (statsroundtrips++, XGetWindowAttributes(__VA_ARGS__))
+#define XGetWindowProperty(...)    (statsroundtrips++, XGetWindowProperty(__VA_ARGS__))
+#define XGetWMHints(...)           (statsroundtrips++, XGetWMHints(__VA_ARGS__))
+#define XGetWMNormalHints(...)     (statsroundtrips++, XGetWMNormalHints(__VA_ARGS__))
+#define XGetWMProtocols(...)       (statsroundtrips++, XGetWMProtocols(__VA_ARGS__))
+#define XGrabPointer(...)          (statsroundtrips++, XGrabPointer(__VA_ARGS__))
+#define XInternAtom(...)           (statsroundtrips++, XInternAtom(__VA_ARGS__))
+#define XQueryPointer(...)         (statsroundtrips++, XQueryPointer(__VA_ARGS__))
+#define XQueryTree(...)            (statsroundtrips++, XQueryTree(__VA_ARGS__))
+#define XSync(...)                 (statsroundtrips++, tracesync(__VA_ARGS__))
+#define drw_map(...)               (statsroundtrips++, tracedrwmap(__VA_ARGS__)) /* XSync */
+#define xcb_res_query_client_ids_reply(...) \
+	(statsroundtrips++, xcb_res_query_client_ids_reply(__VA_ARGS__))
+
+void
+statsbegin(StatMark *mark)
+{
+	mark->t = statsnow();
+	mark->requests = NextRequest(dpy);
+	mark->roundtrips = statsroundtrips;
+	mark->sent = xcb_total_written(xcon);
+	mark->received = xcb_total_read(xcon);
+}
+
+void
+statsdump(IpcBuf *b)
+{
+	char name[64];
+	const char *ks;
+	unsigned int i;
+
+	ipcbufprintf(b, "stats %s\n", stats ? "on" : "off");
+	for (i = 0; i < LASTEvent; i++) {
+		if (evnames[i])
+			statsline(b, "event", evnames[i], &evstats[i]);
+		else {
+			snprintf(name, sizeof(name), "%u", i);
+			statsline(b, "event", name, &evstats[i]);
+		}
+	}
+	for (i = 0; i < LENGTH(keys); i++) {
+		ks = XKeysymToString(keys[i].keysym);
+		snprintf(name, sizeof(name), "%u:0x%x+%s", i, keys[i].mod, ks ? ks : "?");
+		statsline(b, "key", name, &keystats[i]);
+	}
+	for (i = 0; i < LENGTH(buttons); i++) {
+		snprintf(name, sizeof(name), "%u:%u:0x%x+%u", i, buttons[i].click,
+			buttons[i].mask, buttons[i].button);
+		statsline(b, "button", name, &buttonstats[i]);
+	}
+	statsline(b, "loop", "render", &renderstats);
+	statsline(b, "queue", "depth", &queuestats);
+}
+
+/* records the time and X traffic since statsbegin() */
+void
+statsend(Stat *s, StatMark *mark)
+{
+	statsrecord(s, (statsnow() - mark->t) / 1000);
+	s->requests += NextRequest(dpy) - mark->requests;
+	s->roundtrips += statsroundtrips - mark->roundtrips;
+	s->sent += xcb_total_written(xcon) - mark->sent;
+	s->received += xcb_total_read(xcon) - mark->received;
+}
+
+void
+statsline(IpcBuf *b, const char *kind, const char *name, Stat *s)
+{
+	if (!s->count)
+		return;
+	ipcbufprintf(b, "%s %s %llu %llu %llu %llu %llu %llu %llu %llu %llu\n", kind, name,
+		s->count, s->total / s->count, statspercentile(s, 50), statspercentile(s, 99),
+		s->max, s->requests, s->roundtrips, s->sent, s->received);
+}
+
+/* SIGUSR1 */
+void
+statslog(void)
+{
+	IpcBuf b = {0};
+
+	statsdump(&b);
+	fwrite(b.data, 1, b.len, stderr);
+	fflush(stderr);
+	free(b.data);
+}
+
+long long
+statsnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+unsigned long long
+statspercentile(Stat *s, unsigned int pct)
+{
+	unsigned long long n = 0, want = (s->count * pct + 99) / 100;
+	int b;
+
+	for (b = 0; b < STATBUCKETS; b++)
+		if ((n += s->hist[b]) >= want)
+			break;
+	return b ? 1ULL << b : 0;
+}
+
+void
+statsrecord(Stat *s, unsigned long long v)
+{
+	int b;
+
+	for (b = 0; b < STATBUCKETS - 1 && v >> b; b++);
+	s->hist[b]++;
+	s->count++;
+	s->total += v;
+	if (v > s->max)
+		s->max = v;
+}
+
+void
+statsreset(void)
+{
+	memset(evstats, 0, sizeof(evstats));
+	memset(keystats, 0, sizeof(keystats));
+	memset(buttonstats, 0, sizeof(buttonstats));
+	memset(&renderstats, 0, sizeof(renderstats));
+	memset(&queuestats, 0, sizeof(queuestats));
+}
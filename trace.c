@@ -0,0 +1,134 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Activity tracing in the Trace Event format read by chrome://tracing and
+ * Perfetto. While tracing is on (traceenabled in config.h, or "trace on" over
+ * the control socket) begin/end events for the X event handlers, arrange,
+ * arrangemon, the layout function, restack, the bar sections, drw_text,
+ * geticonprop, manage, unmanage and every XSync go into a ring buffer that
+ * keeps the last TRACESIZE events. "trace write [path]" over the socket or
+ * SIGUSR2 writes the buffer to path, by default dwm-trace.json in
+ * $XDG_RUNTIME_DIR (or /tmp). Spans that began before the oldest kept event
+ * show up with their end only.
+ */
+
+#define TRACESIZE    (1 << 16)
+#define TRACEBEGIN(N) do { if (tracing) traceevent('B', (N)); } while (0)
+#define TRACEEND(N)   do { if (tracing) traceevent('E', (N)); } while (0)
+
+typedef struct {
+	long long ts; /* ns, CLOCK_MONOTONIC */
+	const char *name;
+	char ph;
+} TraceEvent;
+
+static int tracedrwtext(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert);
+static void tracedrwmap(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h);
+static void traceenable(int on);
+static void traceevent(char ph, const char *name);
+static void tracelog(void);
+static int tracesync(Display *d, Bool discard);
+static int tracewrite(const char *path);
+
+static int tracing;
+static TraceEvent *tracebuf;
+static unsigned int tracehead, tracelen;
+
+int
+tracedrwtext(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert)
+{
+	int r;
+
+	TRACEBEGIN("drw_text");
+	r = drw_text(drw, x, y, w, h, lpad, text, invert);
+	TRACEEND("drw_text");
+	return r;
+}
+
+void
+tracedrwmap(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
+{
+	TRACEBEGIN("drw_map");
+	drw_map(drw, win, x, y, w, h);
+	TRACEEND("drw_map");
+}
+
+void
+traceenable(int on)
+{
+	if (on && !tracebuf)
+		tracebuf = ecalloc(TRACESIZE, sizeof(TraceEvent));
+	tracing = on;
+}
+
+void
+traceevent(char ph, const char *name)
+{
+	struct timespec ts;
+	TraceEvent *e = &tracebuf[tracehead];
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	e->ts = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	e->name = name;
+	e->ph = ph;
+	tracehead = (tracehead + 1) % TRACESIZE;
+	if (tracelen < TRACESIZE)
+		tracelen++;
+}
+
+/* SIGUSR2 */
+void
+tracelog(void)
+{
+	if (!tracewrite(NULL))
+		fprintf(stderr, "dwm: cannot write trace\n");
+}
+
+int
+tracesync(Display *d, Bool discard)
+{
+	int r;
+
+	TRACEBEGIN("XSync");
+	r = XSync(d, discard);
+	TRACEEND("XSync");
+	return r;
+}
+
+int
+tracewrite(const char *path)
+{
+	char buf[PATH_MAX];
+	const char *dir;
+	unsigned int i;
+	int n;
+	IpcBuf b = {0};
+	TraceEvent *e;
+	FILE *f;
+
+	if (!path) {
+		dir = (dir = getenv("XDG_RUNTIME_DIR")) && *dir ? dir : "/tmp";
+		n = snprintf(buf, sizeof(buf), "%s/dwm-trace.json", dir);
+		if (n < 0 || (size_t)n >= sizeof(buf))
+			return 0;
+		path = buf;
+	}
+	ipcbufprintf(&b, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for (i = 0; i < tracelen; i++) {
+		e = &tracebuf[(tracehead + TRACESIZE - tracelen + i) % TRACESIZE];
+		ipcbufprintf(&b, "%s\n{\"name\":", i ? "," : "");
+		ipcbufjsonstr(&b, e->name);
+		ipcbufprintf(&b, ",\"ph\":\"%c\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":1}",
+			e->ph, e->ts / 1000, e->ts % 1000, (int)getpid());
+	}
+	ipcbufprintf(&b, "\n]}\n");
+	if (!(f = fopen(path, "w"))) {
+		free(b.data);
+		return 0;
+	}
+	n = fwrite(b.data, 1, b.len, f) == b.len;
+	n = !fclose(f) && n;
+	free(b.data);
+	return n;
+}
+
+#define drw_text(...) tracedrwtext(__VA_ARGS__)
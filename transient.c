@@ -1,42 +1,405 @@
-/* cc transient.c -o transient -lX11 */
+/* cc transient.c -o transient -lX11 -lXtst -lXdamage
+ *
+ * Without arguments this maps a fixed-size floating window and, five
+ * seconds later, a transient for it. With -b it drives the running window
+ * manager instead and prints latency percentiles (see "make e2e"):
+ *
+ *   map    XMapWindow until the window manager has mapped the window
+ *   title  _NET_WM_NAME change until the bar has been repainted
+ *   fs     _NET_WM_STATE fullscreen request until the window covers the screen
+ *   key    MODKEY+j (focusstack) until _NET_ACTIVE_WINDOW changes
+ *   unmap  XDestroyWindow until the UnmapNotify and the window manager's
+ *          _NET_CLIENT_LIST update that follows it
+ */
 
+#include <poll.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+#include <X11/extensions/Xdamage.h>
 
-int main(void) {
-	Display *d;
-	Window r, f, t = None;
+#define TIMEOUT 1000 /* ms to wait for the window manager before a sample is lost */
+
+enum { NetWMName, NetWMIcon, NetWMState, NetWMFullscreen, NetActiveWindow,
+       NetClientList, AtomLast };
+
+typedef struct {
+	Window w;
+	int on;
+} FsWait;
+
+typedef struct {
+	Window w;
+	int unmapped;
+} UnmapWait;
+
+typedef struct {
+	const char *name;
+	long long *v;
+	int n, lost;
+} Samples;
+
+static Display *dpy;
+static Window root, bar;
+static Atom atoms[AtomLast];
+static int damageev;
+static int sw, sh;
+
+static long long
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void
+die(const char *msg)
+{
+	fprintf(stderr, "transient: %s\n", msg);
+	exit(1);
+}
+
+static int
+cmpll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+record(Samples *s, long long start, int ok)
+{
+	if (ok)
+		s->v[s->n++] = now() - start;
+	else
+		s->lost++;
+}
+
+static void
+report(Samples *s)
+{
+	if (!s->n) {
+		printf("%-6s %6d samples %6d lost\n", s->name, 0, s->lost);
+		return;
+	}
+	qsort(s->v, s->n, sizeof *s->v, cmpll);
+	printf("%-6s %6d samples %6d lost  p50 %7lldus  p90 %7lldus  p99 %7lldus  max %7lldus\n",
+		s->name, s->n, s->lost, s->v[s->n / 2], s->v[s->n * 9 / 10],
+		s->v[s->n * 99 / 100], s->v[s->n - 1]);
+}
+
+static void
+handle(XEvent *ev)
+{
+	if (ev->type == damageev + XDamageNotify)
+		XDamageSubtract(dpy, ((XDamageNotifyEvent *)ev)->damage, None, None);
+}
+
+/* drops the events still queued from the previous sample */
+static void
+drain(void)
+{
+	XEvent ev;
+
+	XSync(dpy, False);
+	while (XPending(dpy)) {
+		XNextEvent(dpy, &ev);
+		handle(&ev);
+	}
+}
+
+/* waits until match() accepts an event or TIMEOUT runs out */
+static int
+waitfor(int (*match)(XEvent *, void *), void *arg)
+{
+	XEvent ev;
+	struct pollfd pfd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+	long long deadline = now() + TIMEOUT * 1000LL, left;
+
+	for (;;) {
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			handle(&ev);
+			if (match(&ev, arg))
+				return 1;
+		}
+		if ((left = deadline - now()) <= 0)
+			return 0;
+		poll(&pfd, 1, left / 1000 + 1);
+	}
+}
+
+static int
+ismapped(XEvent *ev, void *arg)
+{
+	return ev->type == MapNotify && ev->xmap.window == *(Window *)arg;
+}
+
+static int
+isdamage(XEvent *ev, void *arg)
+{
+	return ev->type == damageev + XDamageNotify
+		&& ((XDamageNotifyEvent *)ev)->drawable == bar;
+}
+
+static int
+isfullscreen(XEvent *ev, void *arg)
+{
+	FsWait *f = arg;
+	XConfigureEvent *cev = &ev->xconfigure;
+
+	return ev->type == ConfigureNotify && cev->window == f->w
+		&& (cev->width >= sw && cev->height >= sh) == f->on;
+}
+
+static int
+isactive(XEvent *ev, void *arg)
+{
+	return ev->type == PropertyNotify && ev->xproperty.window == root
+		&& ev->xproperty.atom == atoms[NetActiveWindow];
+}
+
+static int
+isunmanaged(XEvent *ev, void *arg)
+{
+	UnmapWait *u = arg;
+
+	if (ev->type == UnmapNotify && ev->xunmap.window == u->w)
+		u->unmapped = 1;
+	return u->unmapped && ev->type == PropertyNotify && ev->xproperty.window == root
+		&& ev->xproperty.atom == atoms[NetClientList];
+}
+
+/* the bar is the override-redirect window with WM_CLASS "dwm" */
+static Window
+findbar(void)
+{
+	Window r, p, *kids, w = None;
+	unsigned int i, n;
+	XClassHint ch;
+
+	if (!XQueryTree(dpy, root, &r, &p, &kids, &n))
+		return None;
+	for (i = 0; i < n && !w; i++) {
+		if (!XGetClassHint(dpy, kids[i], &ch))
+			continue;
+		if (ch.res_class && !strcmp(ch.res_class, "dwm"))
+			w = kids[i];
+		XFree(ch.res_name);
+		XFree(ch.res_class);
+	}
+	XFree(kids);
+	return w;
+}
+
+static void
+seticon(Window w)
+{
+	static unsigned long icon[2 + 32 * 32];
+	int i;
+
+	icon[0] = icon[1] = 32;
+	for (i = 0; i < 32 * 32; i++)
+		icon[2 + i] = 0xff000000 | (i * 2654435761u & 0xffffff);
+	XChangeProperty(dpy, w, atoms[NetWMIcon], XA_CARDINAL, 32, PropModeReplace,
+		(unsigned char *)icon, 2 + 32 * 32);
+}
+
+static void
+setfullscreen(Window w, int fs)
+{
+	XEvent ev = { .type = ClientMessage };
+
+	ev.xclient.window = w;
+	ev.xclient.message_type = atoms[NetWMState];
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = fs; /* _NET_WM_STATE_REMOVE / _ADD */
+	ev.xclient.data.l[1] = atoms[NetWMFullscreen];
+	XSendEvent(dpy, root, False, SubstructureNotifyMask | SubstructureRedirectMask, &ev);
+}
+
+/* sets _NET_WM_NAME only, so that one sample is one PropertyNotify */
+static void
+settitle(Window w, int i)
+{
+	char buf[64];
+
+	snprintf(buf, sizeof buf, "title %d", i);
+	XChangeProperty(dpy, w, atoms[NetWMName], XInternAtom(dpy, "UTF8_STRING", False), 8,
+		PropModeReplace, (unsigned char *)buf, strlen(buf));
+}
+
+static void
+presskey(KeySym mod, KeySym key)
+{
+	KeyCode m = XKeysymToKeycode(dpy, mod), k = XKeysymToKeycode(dpy, key);
+
+	XTestFakeKeyEvent(dpy, m, True, CurrentTime);
+	XTestFakeKeyEvent(dpy, k, True, CurrentTime);
+	XTestFakeKeyEvent(dpy, k, False, CurrentTime);
+	XTestFakeKeyEvent(dpy, m, False, CurrentTime);
+	XFlush(dpy);
+}
+
+static void
+bench(int nwin, int ntitle, int nkey, int icons)
+{
+	Window *wins;
+	Samples map = { "map" }, title = { "title" }, fs = { "fs" }, key = { "key" };
+	Samples unmap = { "unmap" };
+	FsWait f;
+	UnmapWait u;
+	long long t;
+	int i, dummy;
+
+	if (!XDamageQueryExtension(dpy, &damageev, &dummy))
+		die("no DAMAGE extension");
+	if (!XTestQueryExtension(dpy, &dummy, &dummy, &dummy, &dummy))
+		die("no XTEST extension");
+	if (!(wins = calloc(nwin, sizeof *wins))
+	|| !(map.v = calloc(nwin, sizeof(long long)))
+	|| !(title.v = calloc(ntitle, sizeof(long long)))
+	|| !(fs.v = calloc(2 * nwin, sizeof(long long)))
+	|| !(key.v = calloc(nkey, sizeof(long long)))
+	|| !(unmap.v = calloc(nwin, sizeof(long long))))
+		die("calloc failed");
+	XSelectInput(dpy, root, PropertyChangeMask);
+
+	for (i = 0; i < nwin; i++) {
+		wins[i] = XCreateSimpleWindow(dpy, root, 0, 0, 200, 200, 0, 0, 0);
+		XSelectInput(dpy, wins[i], StructureNotifyMask);
+		settitle(wins[i], i);
+		if (icons)
+			seticon(wins[i]);
+		t = now();
+		XMapWindow(dpy, wins[i]);
+		XFlush(dpy);
+		record(&map, t, waitfor(ismapped, &wins[i]));
+	}
+
+	if (ntitle) {
+		if (!(bar = findbar()))
+			die("cannot find the bar window");
+		XDamageCreate(dpy, bar, XDamageReportNonEmpty);
+		XSync(dpy, False);
+	}
+	for (i = 0; i < ntitle; i++) {
+		/* the last window mapped has the focus, so its title is in the bar;
+		 * a late repaint of the previous sample must not end this one */
+		drain();
+		t = now();
+		settitle(wins[nwin - 1], nwin + i);
+		XFlush(dpy);
+		record(&title, t, waitfor(isdamage, NULL));
+	}
+
+	for (i = 0; i < 2 * nwin; i++) {
+		f.w = wins[nwin - 1 - i / 2];
+		f.on = !(i % 2);
+		t = now();
+		setfullscreen(f.w, f.on);
+		XFlush(dpy);
+		record(&fs, t, waitfor(isfullscreen, &f));
+	}
+
+	for (i = 0; i < nkey; i++) {
+		t = now();
+		presskey(XK_Super_L, XK_j);
+		record(&key, t, waitfor(isactive, NULL));
+	}
+
+	for (i = 0; i < nwin; i++) {
+		u.w = wins[i];
+		u.unmapped = 0;
+		drain();
+		t = now();
+		XDestroyWindow(dpy, wins[i]);
+		XFlush(dpy);
+		record(&unmap, t, waitfor(isunmanaged, &u));
+	}
+
+	report(&map);
+	report(&title);
+	report(&fs);
+	report(&key);
+	report(&unmap);
+}
+
+static void
+transient(void)
+{
+	Window f, t = None;
 	XSizeHints h;
 	XEvent e;
 
-	d = XOpenDisplay(NULL);
-	if (!d)
-		exit(1);
-	r = DefaultRootWindow(d);
-
-	f = XCreateSimpleWindow(d, r, 100, 100, 400, 400, 0, 0, 0);
+	f = XCreateSimpleWindow(dpy, root, 100, 100, 400, 400, 0, 0, 0);
 	h.min_width = h.max_width = h.min_height = h.max_height = 400;
 	h.flags = PMinSize | PMaxSize;
-	XSetWMNormalHints(d, f, &h);
-	XStoreName(d, f, "floating");
-	XMapWindow(d, f);
+	XSetWMNormalHints(dpy, f, &h);
+	XStoreName(dpy, f, "floating");
+	XMapWindow(dpy, f);
 
-	XSelectInput(d, f, ExposureMask);
+	XSelectInput(dpy, f, ExposureMask);
 	while (1) {
-		XNextEvent(d, &e);
+		XNextEvent(dpy, &e);
 
 		if (t == None) {
 			sleep(5);
-			t = XCreateSimpleWindow(d, r, 50, 50, 100, 100, 0, 0, 0);
-			XSetTransientForHint(d, t, f);
-			XStoreName(d, t, "transient");
-			XMapWindow(d, t);
-			XSelectInput(d, t, ExposureMask);
+			t = XCreateSimpleWindow(dpy, root, 50, 50, 100, 100, 0, 0, 0);
+			XSetTransientForHint(dpy, t, f);
+			XStoreName(dpy, t, "transient");
+			XMapWindow(dpy, t);
+			XSelectInput(dpy, t, ExposureMask);
 		}
 	}
+}
+
+int main(int argc, char *argv[]) {
+	char *names[AtomLast] = {
+		"_NET_WM_NAME", "_NET_WM_ICON", "_NET_WM_STATE",
+		"_NET_WM_STATE_FULLSCREEN", "_NET_ACTIVE_WINDOW", "_NET_CLIENT_LIST",
+	};
+	int i, b = 0, nwin = 50, ntitle = 500, nkey = 500, icons = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-b"))
+			b = 1;
+		else if (!strcmp(argv[i], "-i"))
+			icons = 1;
+		else if (i + 1 < argc && !strcmp(argv[i], "-n"))
+			nwin = atoi(argv[++i]);
+		else if (i + 1 < argc && !strcmp(argv[i], "-t"))
+			ntitle = atoi(argv[++i]);
+		else if (i + 1 < argc && !strcmp(argv[i], "-k"))
+			nkey = atoi(argv[++i]);
+		else
+			die("usage: transient [-b [-i] [-n windows] [-t titles] [-k keys]]");
+	}
+	if (nwin < 1 || ntitle < 0 || nkey < 0)
+		die("counts must not be negative, and there must be a window");
+
+	if (!(dpy = XOpenDisplay(NULL)))
+		exit(1);
+	root = DefaultRootWindow(dpy);
+	sw = DisplayWidth(dpy, DefaultScreen(dpy));
+	sh = DisplayHeight(dpy, DefaultScreen(dpy));
+	XInternAtoms(dpy, names, AtomLast, False, atoms);
+
+	if (b)
+		bench(nwin, ntitle, nkey, icons);
+	else
+		transient();
 
-	XCloseDisplay(d);
+	XCloseDisplay(dpy);
 	exit(0);
 }
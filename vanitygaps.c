@@ -51,6 +51,7 @@ setgaps(int oh, int ov, int ih, int iv)
 	#endif // PERTAG_PATCH
 
 	arrange(selmon);
+	osd("Gaps: %d %d %d %d", oh, ov, ih, iv);
 }
 
 void
@@ -62,6 +63,11 @@ togglegaps(const Arg *arg)
 	enablegaps = !enablegaps;
 	#endif // PERTAG_PATCH
 	arrange(NULL);
+	#if PERTAG_PATCH
+	osd("Gaps: %s", selmon->pertag->enablegaps[selmon->pertag->curtag] ? "on" : "off");
+	#else
+	osd("Gaps: %s", enablegaps ? "on" : "off");
+	#endif // PERTAG_PATCH
 }
 
 void
@@ -150,15 +156,13 @@ incrivgaps(const Arg *arg)
 void
 getgaps(Monitor *m, int *oh, int *ov, int *ih, int *iv, unsigned int *nc)
 {
-	unsigned int n, oe, ie;
+	unsigned int n = m->ntiled, oe, ie;
 	#if PERTAG_PATCH
 	oe = ie = selmon->pertag->enablegaps[selmon->pertag->curtag];
 	#else
 	oe = ie = enablegaps;
 	#endif // PERTAG_PATCH
-	Client *c;
 
-	for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++);
 	if (smartgaps && n == 1) {
 		oe = 0; // outer gaps disabled when only one client
 	}
@@ -176,19 +180,18 @@ getfacts(Monitor *m, int msize, int ssize, float *mf, float *sf, int *mr, int *s
 	unsigned int n;
 	float mfacts = 0, sfacts = 0;
 	int mtotal = 0, stotal = 0;
-	Client *c;
 
-	for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++)
+	for (n = 0; n < m->ntiled; n++)
 		if (n < m->nmaster)
-			mfacts += c->cfact;
+			mfacts += m->tiled[n].cfact;
 		else
-			sfacts += c->cfact;
+			sfacts += m->tiled[n].cfact;
 
-	for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++)
+	for (n = 0; n < m->ntiled; n++)
 		if (n < m->nmaster)
-			mtotal += msize * (c->cfact / mfacts);
+			mtotal += msize * (m->tiled[n].cfact / mfacts);
 		else
-			stotal += ssize * (c->cfact / sfacts);
+			stotal += ssize * (m->tiled[n].cfact / sfacts);
 
 	*mf = mfacts; // total factor of master area
 	*sf = sfacts; // total factor of stack area
@@ -213,7 +216,7 @@ bstack(Monitor *m)
 	int sx = 0, sy = 0, sh = 0, sw = 0;
 	float mfacts, sfacts;
 	int mrest, srest;
-	Client *c;
+	Tiled *t;
 
 	getgaps(m, &oh, &ov, &ih, &iv, &n);
 	if (n == 0)
@@ -234,13 +237,14 @@ bstack(Monitor *m)
 
 	getfacts(m, mw, sw, &mfacts, &sfacts, &mrest, &srest);
 
-	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++) {
+	for (i = 0; i < n; i++) {
+		t = &m->tiled[i];
 		if (i < m->nmaster) {
-			resize(c, mx, my, mw * (c->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*c->bw), mh - (2*c->bw), 0);
-			mx += WIDTH(c) + iv;
+			placetiled(m, t, mx, my, mw * (t->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*t->bw), mh - (2*t->bw));
+			mx += TWIDTH(t) + iv;
 		} else {
-			resize(c, sx, sy, sw * (c->cfact / sfacts) + ((i - m->nmaster) < srest ? 1 : 0) - (2*c->bw), sh - (2*c->bw), 0);
-			sx += WIDTH(c) + iv;
+			placetiled(m, t, sx, sy, sw * (t->cfact / sfacts) + ((i - m->nmaster) < srest ? 1 : 0) - (2*t->bw), sh - (2*t->bw));
+			sx += TWIDTH(t) + iv;
 		}
 	}
 }
@@ -254,7 +258,7 @@ bstackhoriz(Monitor *m)
 	int sx = 0, sy = 0, sh = 0, sw = 0;
 	float mfacts, sfacts;
 	int mrest, srest;
-	Client *c;
+	Tiled *t;
 
 	getgaps(m, &oh, &ov, &ih, &iv, &n);
 	if (n == 0)
@@ -276,13 +280,14 @@ bstackhoriz(Monitor *m)
 
 	getfacts(m, mw, sh, &mfacts, &sfacts, &mrest, &srest);
 
-	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++) {
+	for (i = 0; i < n; i++) {
+		t = &m->tiled[i];
 		if (i < m->nmaster) {
-			resize(c, mx, my, mw * (c->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*c->bw), mh - (2*c->bw), 0);
-			mx += WIDTH(c) + iv;
+			placetiled(m, t, mx, my, mw * (t->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*t->bw), mh - (2*t->bw));
+			mx += TWIDTH(t) + iv;
 		} else {
-			resize(c, sx, sy, sw - (2*c->bw), sh * (c->cfact / sfacts) + ((i - m->nmaster) < srest ? 1 : 0) - (2*c->bw), 0);
-			sy += HEIGHT(c) + ih;
+			placetiled(m, t, sx, sy, sw - (2*t->bw), sh * (t->cfact / sfacts) + ((i - m->nmaster) < srest ? 1 : 0) - (2*t->bw));
+			sy += THEIGHT(t) + ih;
 		}
 	}
 }
@@ -302,7 +307,7 @@ centeredmaster(Monitor *m)
 	float mfacts = 0, lfacts = 0, rfacts = 0;
 	int mtotal = 0, ltotal = 0, rtotal = 0;
 	int mrest = 0, lrest = 0, rrest = 0;
-	Client *c;
+	Tiled *t;
 
 	getgaps(m, &oh, &ov, &ih, &iv, &n);
 	if (n == 0)
@@ -337,40 +342,41 @@ centeredmaster(Monitor *m)
 	}
 
 	/* calculate facts */
-	for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++) {
-		if (!m->nmaster || n < m->nmaster)
-			mfacts += c->cfact;
-		else if ((n - m->nmaster) % 2)
-			lfacts += c->cfact; // total factor of left hand stack area
+	for (i = 0; i < n; i++) {
+		if (!m->nmaster || i < m->nmaster)
+			mfacts += m->tiled[i].cfact;
+		else if ((i - m->nmaster) % 2)
+			lfacts += m->tiled[i].cfact; // total factor of left hand stack area
 		else
-			rfacts += c->cfact; // total factor of right hand stack area
+			rfacts += m->tiled[i].cfact; // total factor of right hand stack area
 	}
 
-	for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++)
-		if (!m->nmaster || n < m->nmaster)
-			mtotal += mh * (c->cfact / mfacts);
-		else if ((n - m->nmaster) % 2)
-			ltotal += lh * (c->cfact / lfacts);
+	for (i = 0; i < n; i++)
+		if (!m->nmaster || i < m->nmaster)
+			mtotal += mh * (m->tiled[i].cfact / mfacts);
+		else if ((i - m->nmaster) % 2)
+			ltotal += lh * (m->tiled[i].cfact / lfacts);
 		else
-			rtotal += rh * (c->cfact / rfacts);
+			rtotal += rh * (m->tiled[i].cfact / rfacts);
 
 	mrest = mh - mtotal;
 	lrest = lh - ltotal;
 	rrest = rh - rtotal;
 
-	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++) {
+	for (i = 0; i < n; i++) {
+		t = &m->tiled[i];
 		if (!m->nmaster || i < m->nmaster) {
 			/* nmaster clients are stacked vertically, in the center of the screen */
-			resize(c, mx, my, mw - (2*c->bw), mh * (c->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*c->bw), 0);
-			my += HEIGHT(c) + ih;
+			placetiled(m, t, mx, my, mw - (2*t->bw), mh * (t->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*t->bw));
+			my += THEIGHT(t) + ih;
 		} else {
 			/* stack clients are stacked vertically */
 			if ((i - m->nmaster) % 2 ) {
-				resize(c, lx, ly, lw - (2*c->bw), lh * (c->cfact / lfacts) + ((i - 2*m->nmaster) < 2*lrest ? 1 : 0) - (2*c->bw), 0);
-				ly += HEIGHT(c) + ih;
+				placetiled(m, t, lx, ly, lw - (2*t->bw), lh * (t->cfact / lfacts) + ((i - 2*m->nmaster) < 2*lrest ? 1 : 0) - (2*t->bw));
+				ly += THEIGHT(t) + ih;
 			} else {
-				resize(c, rx, ry, rw - (2*c->bw), rh * (c->cfact / rfacts) + ((i - 2*m->nmaster) < 2*rrest ? 1 : 0) - (2*c->bw), 0);
-				ry += HEIGHT(c) + ih;
+				placetiled(m, t, rx, ry, rw - (2*t->bw), rh * (t->cfact / rfacts) + ((i - 2*m->nmaster) < 2*rrest ? 1 : 0) - (2*t->bw));
+				ry += THEIGHT(t) + ih;
 			}
 		}
 	}
@@ -385,7 +391,7 @@ centeredfloatingmaster(Monitor *m)
 	int oh, ov, ih, iv, mrest, srest;
 	int mx = 0, my = 0, mh = 0, mw = 0;
 	int sx = 0, sy = 0, sh = 0, sw = 0;
-	Client *c;
+	Tiled *t;
 
 	getgaps(m, &oh, &ov, &ih, &iv, &n);
 	if (n == 0)
@@ -417,16 +423,18 @@ centeredfloatingmaster(Monitor *m)
 
 	getfacts(m, mw, sw, &mfacts, &sfacts, &mrest, &srest);
 
-	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
+	for (i = 0; i < n; i++) {
+		t = &m->tiled[i];
 		if (i < m->nmaster) {
 			/* nmaster clients are stacked horizontally, in the center of the screen */
-			resize(c, mx, my, mw * (c->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*c->bw), mh - (2*c->bw), 0);
-			mx += WIDTH(c) + iv*mivf;
+			placetiled(m, t, mx, my, mw * (t->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*t->bw), mh - (2*t->bw));
+			mx += TWIDTH(t) + iv*mivf;
 		} else {
 			/* stack clients are stacked horizontally */
-			resize(c, sx, sy, sw * (c->cfact / sfacts) + ((i - m->nmaster) < srest ? 1 : 0) - (2*c->bw), sh - (2*c->bw), 0);
-			sx += WIDTH(c) + iv;
+			placetiled(m, t, sx, sy, sw * (t->cfact / sfacts) + ((i - m->nmaster) < srest ? 1 : 0) - (2*t->bw), sh - (2*t->bw));
+			sx += TWIDTH(t) + iv;
 		}
+	}
 }
 
 /*
@@ -442,7 +450,7 @@ deck(Monitor *m)
 	int sx = 0, sy = 0, sh = 0, sw = 0;
 	float mfacts, sfacts;
 	int mrest, srest;
-	Client *c;
+	Tiled *t;
 
 	getgaps(m, &oh, &ov, &ih, &iv, &n);
 	if (n == 0)
@@ -465,13 +473,15 @@ deck(Monitor *m)
 	if (n - m->nmaster > 0) /* override layout symbol */
 		snprintf(m->ltsymbol, sizeof m->ltsymbol, "D %d", n - m->nmaster);
 #endif
-	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
+	for (i = 0; i < n; i++) {
+		t = &m->tiled[i];
 		if (i < m->nmaster) {
-			resize(c, mx, my, mw - (2*c->bw), mh * (c->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*c->bw), 0);
-			my += HEIGHT(c) + ih;
+			placetiled(m, t, mx, my, mw - (2*t->bw), mh * (t->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*t->bw));
+			my += THEIGHT(t) + ih;
 		} else {
-			resize(c, sx, sy, sw - (2*c->bw), sh - (2*c->bw), 0);
+			placetiled(m, t, sx, sy, sw - (2*t->bw), sh - (2*t->bw));
 		}
+	}
 }
 
 /*
@@ -481,11 +491,11 @@ deck(Monitor *m)
 void
 fibonacci(Monitor *m, int s)
 {
-	unsigned int i, n;
+	unsigned int i, j, n;
 	int nx, ny, nw, nh;
 	int oh, ov, ih, iv;
 	int nv, hrest = 0, wrest = 0, r = 1;
-	Client *c;
+	Tiled *t;
 
 	getgaps(m, &oh, &ov, &ih, &iv, &n);
 	if (n == 0)
@@ -496,10 +506,11 @@ fibonacci(Monitor *m, int s)
 	nw = m->ww - 2*ov;
 	nh = m->wh - 2*oh;
 
-	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next)) {
+	for (i = 0, j = 0; j < n; j++) {
+		t = &m->tiled[j];
 		if (r) {
-			if ((i % 2 && (nh - ih) / 2 <= (bh + 2*c->bw))
-			   || (!(i % 2) && (nw - iv) / 2 <= (bh + 2*c->bw))) {
+			if ((i % 2 && (nh - ih) / 2 <= (bh + 2*t->bw))
+			   || (!(i % 2) && (nw - iv) / 2 <= (bh + 2*t->bw))) {
 				r = 0;
 			}
 			if (r && i < n - 1) {
@@ -561,7 +572,7 @@ fibonacci(Monitor *m, int s)
 			i++;
 		}
 
-		resize(c, nx, ny, nw - (2*c->bw), nh - (2*c->bw), False);
+		placetiled(m, t, nx, ny, nw - (2*t->bw), nh - (2*t->bw));
 	}
 }
 
@@ -587,7 +598,7 @@ gaplessgrid(Monitor *m)
 	unsigned int i, n;
 	int x, y, cols, rows, ch, cw, cn, rn, rrest, crest; // counters
 	int oh, ov, ih, iv;
-	Client *c;
+	Tiled *t;
 
 	getgaps(m, &oh, &ov, &ih, &iv, &n);
 	if (n == 0)
@@ -609,18 +620,18 @@ gaplessgrid(Monitor *m)
 	x = m->wx + ov;
 	y = m->wy + oh;
 
-	for (i = 0, c = nexttiled(m->clients); c; i++, c = nexttiled(c->next)) {
+	for (i = 0; i < n; i++) {
+		t = &m->tiled[i];
 		if (i/rows + 1 > cols - n%cols) {
 			rows = n/cols + 1;
 			ch = (m->wh - 2*oh - ih * (rows - 1)) / rows;
 			rrest = (m->wh - 2*oh - ih * (rows - 1)) - ch * rows;
 		}
-		resize(c,
+		placetiled(m, t,
 			x,
 			y + rn*(ch + ih) + MIN(rn, rrest),
-			cw + (cn < crest ? 1 : 0) - 2*c->bw,
-			ch + (rn < rrest ? 1 : 0) - 2*c->bw,
-			0);
+			cw + (cn < crest ? 1 : 0) - 2*t->bw,
+			ch + (rn < rrest ? 1 : 0) - 2*t->bw);
 		rn++;
 		if (rn >= rows) {
 			rn = 0;
@@ -640,7 +651,7 @@ grid(Monitor *m)
 	unsigned int i, n;
 	int cx, cy, cw, ch, cc, cr, chrest, cwrest, cols, rows;
 	int oh, ov, ih, iv;
-	Client *c;
+	Tiled *t;
 
 	getgaps(m, &oh, &ov, &ih, &iv, &n);
 
@@ -655,12 +666,13 @@ grid(Monitor *m)
 	cw = (m->ww - 2*ov - iv * (cols - 1)) / (cols ? cols : 1);
 	chrest = (m->wh - 2*oh - ih * (rows - 1)) - ch * rows;
 	cwrest = (m->ww - 2*ov - iv * (cols - 1)) - cw * cols;
-	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++) {
+	for (i = 0; i < n; i++) {
+		t = &m->tiled[i];
 		cc = i / rows;
 		cr = i % rows;
 		cx = m->wx + ov + cc * (cw + iv) + MIN(cc, cwrest);
 		cy = m->wy + oh + cr * (ch + ih) + MIN(cr, chrest);
-		resize(c, cx, cy, cw + (cc < cwrest ? 1 : 0) - 2*c->bw, ch + (cr < chrest ? 1 : 0) - 2*c->bw, False);
+		placetiled(m, t, cx, cy, cw + (cc < cwrest ? 1 : 0) - 2*t->bw, ch + (cr < chrest ? 1 : 0) - 2*t->bw);
 	}
 }
 
@@ -670,7 +682,7 @@ grid(Monitor *m)
  */
 void
 horizgrid(Monitor *m) {
-	Client *c;
+	Tiled *t;
 	unsigned int n, i;
 	int oh, ov, ih, iv;
 	int mx = 0, my = 0, mh = 0, mw = 0;
@@ -704,29 +716,31 @@ horizgrid(Monitor *m) {
 	}
 
 	/* calculate facts */
-	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
+	for (i = 0; i < n; i++)
 		if (i < ntop)
-			mfacts += c->cfact;
+			mfacts += m->tiled[i].cfact;
 		else
-			sfacts += c->cfact;
+			sfacts += m->tiled[i].cfact;
 
-	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
+	for (i = 0; i < n; i++)
 		if (i < ntop)
-			mtotal += mh * (c->cfact / mfacts);
+			mtotal += mh * (m->tiled[i].cfact / mfacts);
 		else
-			stotal += sw * (c->cfact / sfacts);
+			stotal += sw * (m->tiled[i].cfact / sfacts);
 
 	mrest = mh - mtotal;
 	srest = sw - stotal;
 
-	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
+	for (i = 0; i < n; i++) {
+		t = &m->tiled[i];
 		if (i < ntop) {
-			resize(c, mx, my, mw * (c->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*c->bw), mh - (2*c->bw), 0);
-			mx += WIDTH(c) + iv;
+			placetiled(m, t, mx, my, mw * (t->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*t->bw), mh - (2*t->bw));
+			mx += TWIDTH(t) + iv;
 		} else {
-			resize(c, sx, sy, sw * (c->cfact / sfacts) + ((i - ntop) < srest ? 1 : 0) - (2*c->bw), sh - (2*c->bw), 0);
-			sx += WIDTH(c) + iv;
+			placetiled(m, t, sx, sy, sw * (t->cfact / sfacts) + ((i - ntop) < srest ? 1 : 0) - (2*t->bw), sh - (2*t->bw));
+			sx += TWIDTH(t) + iv;
 		}
+	}
 }
 
 /*
@@ -736,13 +750,13 @@ horizgrid(Monitor *m) {
 void
 nrowgrid(Monitor *m)
 {
-	unsigned int n;
+	unsigned int i, n;
 	int ri = 0, ci = 0;  /* counters */
 	int oh, ov, ih, iv;                         /* vanitygap settings */
 	unsigned int cx, cy, cw, ch;                /* client geometry */
 	unsigned int uw = 0, uh = 0, uc = 0;        /* utilization trackers */
 	unsigned int cols, rows = m->nmaster + 1;
-	Client *c;
+	Tiled *t;
 
 	/* count clients */
 	getgaps(m, &oh, &ov, &ih, &iv, &n);
@@ -766,7 +780,8 @@ nrowgrid(Monitor *m)
 	ch = (m->wh - 2*oh - ih*(rows - 1)) / rows;
 	uh = ch;
 
-	for (c = nexttiled(m->clients); c; c = nexttiled(c->next), ci++) {
+	for (i = 0; i < n; i++, ci++) {
+		t = &m->tiled[i];
 		if (ci == cols) {
 			uw = 0;
 			ci = 0;
@@ -783,7 +798,7 @@ nrowgrid(Monitor *m)
 		cw = (m->ww - 2*ov - uw) / (cols - ci);
 		uw += cw + iv;
 
-		resize(c, cx, cy, cw - (2*c->bw), ch - (2*c->bw), 0);
+		placetiled(m, t, cx, cy, cw - (2*t->bw), ch - (2*t->bw));
 	}
 }
 
@@ -799,7 +814,7 @@ tile(Monitor *m)
 	int sx = 0, sy = 0, sh = 0, sw = 0;
 	float mfacts, sfacts;
 	int mrest, srest;
-	Client *c;
+	Tiled *t;
 
 	getgaps(m, &oh, &ov, &ih, &iv, &n);
 	if (n == 0)
@@ -819,14 +834,16 @@ tile(Monitor *m)
 
 	getfacts(m, mh, sh, &mfacts, &sfacts, &mrest, &srest);
 
-	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
+	for (i = 0; i < n; i++) {
+		t = &m->tiled[i];
 		if (i < m->nmaster) {
-			resize(c, mx, my, mw - (2*c->bw), mh * (c->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*c->bw), 0);
-			if (my + HEIGHT(c) + ih < m->wh)
-				my += HEIGHT(c) + ih;
+			placetiled(m, t, mx, my, mw - (2*t->bw), mh * (t->cfact / mfacts) + (i < mrest ? 1 : 0) - (2*t->bw));
+			if (my + THEIGHT(t) + ih < m->wh)
+				my += THEIGHT(t) + ih;
 		} else {
-			resize(c, sx, sy, sw - (2*c->bw), sh * (c->cfact / sfacts) + ((i - m->nmaster) < srest ? 1 : 0) - (2*c->bw), 0);
-			if (sy + HEIGHT(c) + ih < m->wh)
-				sy += HEIGHT(c) + ih;
+			placetiled(m, t, sx, sy, sw - (2*t->bw), sh * (t->cfact / sfacts) + ((i - m->nmaster) < srest ? 1 : 0) - (2*t->bw));
+			if (sy + THEIGHT(t) + ih < m->wh)
+				sy += THEIGHT(t) + ih;
 		}
+	}
 }